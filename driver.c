@@ -0,0 +1,242 @@
+/* driver.c
+ * MP3
+ *
+ * Purpose: Benchmarks list_sort directly, without lab3 and its input.  For
+ *		each pattern, size and sort type it builds a fresh list, times one
+ *		list_sort call with the monotonic clock, and checks the list is in
+ *		order.  After the warmup runs it repeats this and reports the median,
+ *		95th percentile, minimum and maximum times as CSV or JSON on stdout.
+ *
+ *		Usage: ./driver [-t types] [-p patterns] [-n sizes] [-r reps]
+ *		                [-w warmup] [-q max] [-f csv|json] [-x seed]
+ *		                [-j threads] [-m] [-s]
+ *
+ *		-t, -p, -n: comma separated lists, by default sort types 1 to 10,
+ *		    patterns 1 to 6 (see pattern.c) and sizes 1000 to 10000000
+ *		-r, -w: timed and untimed runs of each test, by default 5 and 1
+ *		-q: largest list for the quadratic sorts 1, 2 and 3, by default
+ *		    16000.  The recursive selection sort also recurses once per
+ *		    element, so much larger lists overflow the stack.
+ *		-j: threads for sort type 9, by default one per processor
+ *		-m, -s: plain malloc nodes and separate records, as for lab3
+ *
+ * Assumptions: The list is built outside the timed part, from the same
+ *		keys for every run of a test.  Each test is one row; tests skipped
+ *		by -q are reported on stderr.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "datatypes.h"
+#include "list.h"
+#include "sas_support.h"
+#include "pattern.h"
+
+// most entries in a comma separated option
+#define DRIVER_MAX_LIST 32
+
+// Private functions used in this file only.
+int DriverParse(const char *text, int *values, int low, int high);
+double DriverRun(const int *keys, int size, int sort_type, int mode, int threads);
+int DriverCompareTime(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    int types[DRIVER_MAX_LIST] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    int patterns[DRIVER_MAX_LIST] = { 1, 2, 3, 4, 5, 6 };
+    int sizes[DRIVER_MAX_LIST] = { 1000, 10000, 100000, 1000000, 10000000 };
+    int type_count = LIST_SORT_TYPES, pattern_count = 6, size_count = 5;
+    int reps = 5, warmup = 1, quadratic_max = 16000, threads = 0;
+    int mode = LIST_POOL | LIST_INTRUSIVE;
+    int json = 0, rows = 0;
+    unsigned int seed = 1;
+    int *keys;
+    double *times;
+    int t, p, n, r, i;
+
+    for (i = 1; i < argc; i++) {
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        int used = 1;
+
+        if (strcmp(argv[i], "-m") == 0) {
+            mode &= ~LIST_POOL;
+            used = 0;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            mode &= ~LIST_INTRUSIVE;
+            used = 0;
+        } else if (value == NULL) {
+            used = -1;
+        } else if (strcmp(argv[i], "-t") == 0) {
+            type_count = DriverParse(value, types, 1, LIST_SORT_TYPES);
+            used = (type_count > 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            pattern_count = DriverParse(value, patterns, 1, PATTERN_COUNT);
+            used = (pattern_count > 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-n") == 0) {
+            size_count = DriverParse(value, sizes, 1, 100000000);
+            used = (size_count > 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-r") == 0) {
+            reps = atoi(value);
+            used = (reps > 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            warmup = atoi(value);
+            used = (warmup >= 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quadratic_max = atoi(value);
+        } else if (strcmp(argv[i], "-j") == 0) {
+            threads = atoi(value);
+            used = (threads >= 0) ? 1 : -1;
+        } else if (strcmp(argv[i], "-x") == 0) {
+            seed = (unsigned int) strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            json = (strcmp(value, "json") == 0);
+            used = (json || strcmp(value, "csv") == 0) ? 1 : -1;
+        } else {
+            used = -1;
+        }
+        if (used < 0) {
+            fprintf(stderr, "Usage: ./driver [-t types] [-p patterns] "
+                    "[-n sizes] [-r reps] [-w warmup] [-q max] [-f csv|json] "
+                    "[-x seed] [-j threads] [-m] [-s]\n");
+            exit(1);
+        }
+        i += used;
+    }
+
+    times = (double *) malloc(reps * sizeof(double));
+    if (times == NULL) {
+        fprintf(stderr, "driver: no memory\n");
+        exit(1);
+    }
+    if (json) {
+        printf("[");
+    } else {
+        printf("sort_type,pattern,size,reps,median_ms,p95_ms,min_ms,max_ms\n");
+    }
+    for (p = 0; p < pattern_count; p++) {
+        for (n = 0; n < size_count; n++) {
+            keys = (int *) malloc(sizes[n] * sizeof(int));
+            if (keys == NULL) {
+                fprintf(stderr, "driver: no memory for %d keys\n", sizes[n]);
+                exit(1);
+            }
+            pattern_fill(keys, sizes[n], patterns[p], seed);
+            for (t = 0; t < type_count; t++) {
+                if (types[t] <= 3 && sizes[n] > quadratic_max) {
+                    fprintf(stderr, "driver: skipped sort %d of %d %s keys "
+                            "(-q %d)\n", types[t], sizes[n],
+                            pattern_name(patterns[p]), quadratic_max);
+                    continue;
+                }
+                for (r = 0; r < warmup; r++) {
+                    DriverRun(keys, sizes[n], types[t], mode, threads);
+                }
+                for (r = 0; r < reps; r++) {
+                    times[r] = DriverRun(keys, sizes[n], types[t], mode, threads);
+                }
+                // nearest rank percentiles
+                qsort(times, reps, sizeof(double), DriverCompareTime);
+                if (json) {
+                    printf("%s\n  {\"sort_type\": %d, \"pattern\": \"%s\", "
+                            "\"size\": %d, \"reps\": %d, \"median_ms\": %.3f, "
+                            "\"p95_ms\": %.3f, \"min_ms\": %.3f, "
+                            "\"max_ms\": %.3f}", rows > 0 ? "," : "",
+                            types[t], pattern_name(patterns[p]), sizes[n],
+                            reps, times[(reps - 1) / 2],
+                            times[(95 * reps + 99) / 100 - 1], times[0],
+                            times[reps - 1]);
+                } else {
+                    printf("%d,%s,%d,%d,%.3f,%.3f,%.3f,%.3f\n", types[t],
+                            pattern_name(patterns[p]), sizes[n], reps,
+                            times[(reps - 1) / 2],
+                            times[(95 * reps + 99) / 100 - 1], times[0],
+                            times[reps - 1]);
+                }
+                fflush(stdout);
+                rows++;
+            }
+            free(keys);
+        }
+    }
+    if (json) {
+        printf("\n]\n");
+    }
+    free(times);
+    return 0;
+}
+
+/*** Private Functions ***/
+
+/* Reads a comma separated list of integers from low to high into values.
+ * Returns how many there are, or 0 if any is out of range.
+ */
+int DriverParse(const char *text, int *values, int low, int high) {
+    int count = 0;
+    char *end;
+    long value;
+
+    while (count < DRIVER_MAX_LIST) {
+        value = strtol(text, &end, 10);
+        if (end == text || value < low || value > high) {
+            return 0;
+        }
+        values[count++] = (int) value;
+        if (*end != ',') {
+            return (*end == '\0') ? count : 0;
+        }
+        text = end + 1;
+    }
+    return 0;
+}
+
+/* Builds a list of the keys, sorts it and returns the time list_sort took
+ * in milliseconds.  Exits if the list does not come out in order.
+ */
+double DriverRun(const int *keys, int size, int sort_type, int mode, int threads) {
+    ListPtr list_ptr = list_construct_mode(sas_compare, sas_key, mode, NULL);
+    struct timespec start, end;
+    IteratorPtr idx_ptr, next_ptr;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        sas_addtail(list_ptr, keys[i]);
+    }
+    list_set_sort_threads(list_ptr, threads);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    list_sort(list_ptr, sort_type);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    idx_ptr = list_iter_front(list_ptr);
+    for (i = 1; i < size; i++) {
+        next_ptr = list_iter_next(idx_ptr);
+        if (sas_compare(list_access(list_ptr, idx_ptr),
+                    list_access(list_ptr, next_ptr)) < 0) {
+            fprintf(stderr, "driver: sort %d left the list out of order\n",
+                    sort_type);
+            exit(1);
+        }
+        idx_ptr = next_ptr;
+    }
+    if (list_size(list_ptr) != size) {
+        fprintf(stderr, "driver: sort %d lost elements\n", sort_type);
+        exit(1);
+    }
+    list_destruct(list_ptr);
+    return 1000.0 * (end.tv_sec - start.tv_sec)
+        + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+/* qsort comparison for times, smallest first.
+ */
+int DriverCompareTime(const void *a, const void *b) {
+    double time_a = *(const double *) a;
+    double time_b = *(const double *) b;
+
+    return (time_a > time_b) - (time_a < time_b);
+}
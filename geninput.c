@@ -0,0 +1,63 @@
+/* geninput.c 
+ * MP3
+ *
+ * Purpose: Prints the input for one lab3 sort test: a CREATE command, one
+ *		ADDTAIL command for each user in the waiting queue, the SORT 
+ *		command and QUIT.  The user ids follow one of the patterns of 
+ *		pattern.c.
+ *
+ *		Usage: ./geninput size pattern sort_type [seed]
+ *		       ./geninput 16000 1 4 | ./lab3
+ *
+ * Assumptions: lab3 prints the size, the CPU and wall clock times and the
+ *		sort type on one line for the SORT command.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pattern.h"
+
+int main(int argc, char *argv[])
+{
+    int size, pattern, sort_type;
+    unsigned int seed = 1;
+    int *keys;
+    int i;
+
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: ./geninput size pattern sort_type [seed]\n");
+        fprintf(stderr, "  pattern: 1 random, 2 ascending, 3 descending, "
+                "4 nearly sorted, 5 duplicate heavy, 6 sawtooth\n");
+        exit(1);
+    }
+    size = atoi(argv[1]);
+    pattern = atoi(argv[2]);
+    sort_type = atoi(argv[3]);
+    if (argc == 5) {
+        seed = (unsigned int) strtoul(argv[4], NULL, 10);
+    }
+    if (size < 0 || pattern_name(pattern) == NULL) {
+        fprintf(stderr, "geninput: invalid size %d or pattern %d\n", 
+                size, pattern);
+        exit(1);
+    }
+
+    keys = (int *) malloc((size + 1) * sizeof(int));
+    if (keys == NULL) {
+        fprintf(stderr, "geninput: no memory for %d keys\n", size);
+        exit(1);
+    }
+    pattern_fill(keys, size, pattern, seed);
+
+    printf("CREATE 10\n");
+    for (i = 0; i < size; i++) {
+        printf("ADDTAIL %d\n", keys[i]);
+    }
+    printf("SORT %d\n", sort_type);
+    printf("QUIT\n");
+    free(keys);
+    return 0;
+}
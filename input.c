@@ -0,0 +1,248 @@
+/* input.c 
+ * MP3
+ *
+ * Purpose: This file reads the commands for the SAS application.  Standard
+ *		input is read in blocks of INPUT_BLOCK bytes and handed out one line
+ *		at a time, and each command line is split into its fields by hand 
+ *		instead of with sscanf.  When a feed replays millions of commands,
+ *		this parsing was where most of the time went.
+ *
+ * Assumptions: input_line behaves like fgets on stdin and input_scan like
+ *		sscanf(line, "%s%d%d%s", ...), so the commands accepted do not change.
+ *		Nothing else may read stdin through the C library once this file has
+ *		read ahead of it.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "input.h"
+
+// Private functions used in this file only.
+int InputFill(void);
+int InputSpace(char c);
+const char* InputInt(const char *s, int *value);
+
+// the file read from, or -1 for text given to input_from_text, the block
+// read last (or that text) and the part of it not handed out yet
+static int input_fd = STDIN_FILENO;
+static char input_block[INPUT_BLOCK];
+static const char *input_data = input_block;
+static int input_next = 0;
+static int input_end = 0;
+
+/* Reads the next line of standard input into line, like 
+ * fgets(line, size, stdin).
+ *
+ * At most size - 1 characters are stored, and the newline is kept if it
+ * fits.  A longer line is returned in pieces by the following calls.  The
+ * return value is 1 if anything was read and 0 at the end of the input.
+ */
+int input_line(char *line, int size)
+{
+	int count = 0;
+	char c;
+
+	while (count < size - 1) {
+		if (input_next == input_end && !InputFill()) {
+			break;
+		}
+		c = input_data[input_next++];
+		line[count++] = c;
+		if (c == '\n') {
+			break;
+		}
+	}
+	line[count] = '\0';
+	return count > 0;
+}
+
+/* Switches input to another open file, such as a journal to replay, or
+ * back to STDIN_FILENO.  Input not yet handed out from the old file is 
+ * dropped.
+ */
+void input_from(int fd)
+{
+	input_fd = fd;
+	input_data = input_block;
+	input_next = 0;
+	input_end = 0;
+}
+
+/* Switches input to length bytes of text, such as the commands a client of
+ * the server sent.  The text is not copied, so it must stay in place while
+ * it is read.  input_line returns 0 at its end, until input_from is called.
+ */
+void input_from_text(const char *text, int length)
+{
+	input_fd = -1;
+	input_data = text;
+	input_next = 0;
+	input_end = length;
+}
+
+/* Returns the number of bytes already read that input_line has not handed
+ * out, so 0 means the next input_line may wait for input.
+ */
+int input_pending(void)
+{
+	return input_end - input_next;
+}
+
+/* Splits a command line into a command word and up to two integers, like
+ * sscanf(line, "%s%d%d%s", command, input_1, input_2, junk).
+ *
+ * Returns the number of fields found, which is 4 if anything follows the
+ * second integer, or -1 if the line holds only white space.  As with 
+ * sscanf, an integer that is not found leaves its variable unchanged.
+ */
+int input_scan(const char *line, char *command, int *input_1, int *input_2)
+{
+	const char *s = line;
+	const char *end;
+	int count = 0;
+
+	while (InputSpace(*s)) {
+		s++;
+	}
+	if (*s == '\0') {
+		return -1;
+	}
+	while (*s != '\0' && !InputSpace(*s)) {
+		*command++ = *s++;
+	}
+	*command = '\0';
+	count = 1;
+
+	end = InputInt(s, input_1);
+	if (end == NULL) {
+		return count;
+	}
+	count = 2;
+	s = end;
+
+	end = InputInt(s, input_2);
+	if (end == NULL) {
+		return count;
+	}
+	count = 3;
+	s = end;
+
+	while (InputSpace(*s)) {
+		s++;
+	}
+	if (*s != '\0') {
+		count = 4;
+	}
+	return count;
+}
+
+/* Splits a command line into a command word and one more word, like
+ * sscanf(line, "%s%s%s", command, word, junk), for commands that take a
+ * file name.
+ *
+ * Returns the number of words found, which is 3 if anything follows the
+ * second word, or -1 if the line holds only white space.
+ */
+int input_scan_word(const char *line, char *command, char *word)
+{
+	const char *s = line;
+	char *field[2];
+	int count = 0;
+
+	field[0] = command;
+	field[1] = word;
+	while (1) {
+		while (InputSpace(*s)) {
+			s++;
+		}
+		if (*s == '\0') {
+			return (count == 0) ? -1 : count;
+		}
+		if (count == 2) {
+			return 3;
+		}
+		while (*s != '\0' && !InputSpace(*s)) {
+			*field[count]++ = *s++;
+		}
+		*field[count] = '\0';
+		count++;
+	}
+}
+
+/*** Private Functions ***/
+
+/* Reads the next block of standard input.  Returns 0 at the end of the
+ * input or on an error, like fgets.
+ */
+int InputFill(void) {
+	ssize_t got;
+
+	if (input_fd < 0) {
+		return 0; // text from input_from_text is all there is
+	}
+	input_data = input_block;
+	do {
+		got = read(input_fd, input_block, INPUT_BLOCK);
+	} while (got < 0 && errno == EINTR);
+	input_next = 0;
+	input_end = (got > 0) ? (int) got : 0;
+	return input_end > 0;
+}
+
+/* Returns 1 for the white space characters of isspace in the C locale.
+ */
+int InputSpace(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Reads a decimal integer after optional white space, the way %d does.
+ * The value is clamped to the range of a long and then cut to an int, as
+ * the C library does.  Returns the character after the integer, or NULL
+ * and leaves value alone if there is none.
+ */
+const char* InputInt(const char *s, int *value) {
+	unsigned long magnitude = 0;
+	unsigned long limit = LONG_MAX;
+	int negative = 0;
+	int overflow = 0;
+	int digit;
+
+	while (InputSpace(*s)) {
+		s++;
+	}
+	if (*s == '-' || *s == '+') {
+		negative = (*s == '-');
+		s++;
+	}
+	if (*s < '0' || *s > '9') {
+		return NULL;
+	}
+	if (negative) {
+		limit = (unsigned long) LONG_MAX + 1;
+	}
+	while (*s >= '0' && *s <= '9') {
+		digit = *s++ - '0';
+		if (magnitude > (limit - digit) / 10) {
+			overflow = 1;
+		}
+		else {
+			magnitude = magnitude * 10 + digit;
+		}
+	}
+	if (overflow) {
+		magnitude = limit;
+	}
+	if (negative) {
+		*value = (int) (long) (0 - magnitude);
+	}
+	else {
+		*value = (int) (long) magnitude;
+	}
+	return s;
+}
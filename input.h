@@ -0,0 +1,21 @@
+/* input.h 
+ * MP3
+ *
+ * Purpose: Public functions for reading commands from standard input in 
+ * large blocks, and for splitting a command line into its fields.
+ *
+ * Assumptions: All input from stdin goes through these functions, since 
+ * the block reads take input ahead of the C library stream.
+ *
+ * Bugs:
+ */
+
+// size of each block read from standard input
+#define INPUT_BLOCK 65536
+
+int input_line(char *line, int size);
+void input_from(int fd);
+void input_from_text(const char *text, int length);
+int input_pending(void);
+int input_scan(const char *line, char *command, int *input_1, int *input_2);
+int input_scan_word(const char *line, char *command, char *word);
@@ -0,0 +1,163 @@
+/* journal.c 
+ * MP3
+ *
+ * Purpose: This file keeps an append-only journal of the commands that 
+ *		change the lists.  Replaying the journal through lab3 rebuilds the
+ *		lists after lab3 stops for any reason.
+ *
+ *		Each command is logged as a line of text, in the same form as it was
+ *		typed.  ADDSU is logged as one line holding the whole record, so a
+ *		replay does not go through the prompts of sas_record_fill.
+ *
+ *		Syncing each command to disk would limit lab3 to a few thousand
+ *		commands a second.  Instead the logged lines are buffered and written
+ *		and synced together (group commit): when the group interval has 
+ *		passed since the last commit, when the buffer is full, and whenever
+ *		lab3 has no more input to work on.  A crash loses at most the
+ *		commands of the last group interval, and the lists recovered are 
+ *		always those after some prefix of the commands.
+ *
+ * Assumptions: Only one lab3 appends to a journal at a time.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "datatypes.h"
+#include "journal.h"
+
+// Private functions used in this file only.
+long JournalNow(void);
+
+static int journal_fd = -1;
+static long journal_group = 0;      // group interval in milliseconds
+static long journal_last = 0;       // time of the last commit
+static char journal_buffer[JOURNAL_BLOCK];
+static int journal_used = 0;
+
+/* Opens a journal to append to, creating it if needed.
+ *
+ * group_ms: longest time in milliseconds a logged command may wait before
+ *           it is synced to disk.  0 syncs every command as it is logged.
+ *
+ * Returns 0, or -1 with errno set if the journal cannot be opened.
+ */
+int journal_open(const char *file, int group_ms)
+{
+    journal_fd = open(file, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (journal_fd < 0) {
+        return -1;
+    }
+    journal_group = group_ms;
+    journal_last = JournalNow();
+    journal_used = 0;
+    return 0;
+}
+
+/* Logs one command line.  A newline is added if the line has none.  Does
+ * nothing if no journal is open.
+ */
+void journal_log(const char *line)
+{
+    size_t length = strlen(line);
+    int newline = (length == 0 || line[length - 1] != '\n');
+
+    if (journal_fd < 0) {
+        return;
+    }
+    if (journal_used + length + newline > JOURNAL_BLOCK) {
+        journal_commit();
+    }
+    memcpy(journal_buffer + journal_used, line, length);
+    journal_used += length;
+    if (newline) {
+        journal_buffer[journal_used++] = '\n';
+    }
+    if (journal_group == 0 || JournalNow() - journal_last >= journal_group) {
+        journal_commit();
+    }
+}
+
+/* Logs an ADDSU command with the whole record on one line.  The floats 
+ * are printed with enough digits to be read back exactly.
+ */
+void journal_log_record(const su_info_t *rec)
+{
+    char line[256];
+
+    snprintf(line, sizeof(line), "ADDSU %d %d %d %d %d %.9g %d %.9g %d\n",
+            rec->su_id, rec->ip_address, rec->access_point, rec->authenticated,
+            rec->privacy, rec->band, rec->channel, rec->data_rate,
+            rec->time_received);
+    journal_log(line);
+}
+
+/* Reads back a record logged by journal_log_record.  Returns 1 if the 
+ * line holds a whole record, else 0.
+ */
+int journal_scan_record(const char *line, su_info_t *rec)
+{
+    memset(rec, 0, sizeof(su_info_t));
+    return sscanf(line, "%*s%d%d%d%d%d%f%d%f%d", &rec->su_id, 
+            &rec->ip_address, &rec->access_point, &rec->authenticated,
+            &rec->privacy, &rec->band, &rec->channel, &rec->data_rate,
+            &rec->time_received) == 9;
+}
+
+/* Writes the logged commands to the journal and syncs it to disk.
+ */
+void journal_commit(void)
+{
+    ssize_t done;
+    int next = 0;
+
+    if (journal_fd < 0) {
+        return;
+    }
+    while (next < journal_used) {
+        done = write(journal_fd, journal_buffer + next, journal_used - next);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("journal");
+            break;
+        }
+        next += done;
+    }
+    if (journal_used > 0) {
+        fdatasync(journal_fd);
+    }
+    journal_used = 0;
+    journal_last = JournalNow();
+}
+
+/* Commits what is left and closes the journal.
+ */
+void journal_close(void)
+{
+    if (journal_fd < 0) {
+        return;
+    }
+    journal_commit();
+    close(journal_fd);
+    journal_fd = -1;
+}
+
+/*** Private Functions ***/
+
+/* Returns a monotonic time in milliseconds.
+ */
+long JournalNow(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000L + now.tv_nsec / 1000000L;
+}
@@ -0,0 +1,21 @@
+/* journal.h 
+ * MP3
+ *
+ * Purpose: Public functions for the write-ahead journal of the commands 
+ * that change the lists, used to recover them after a crash.
+ *
+ * Assumptions: A command is logged before it is carried out.  Logged 
+ * commands are synced to disk in groups, at most every group interval.
+ *
+ * Bugs: None known.
+ */
+
+// size of the buffer of logged commands not yet written
+#define JOURNAL_BLOCK 65536
+
+int journal_open(const char *file, int group_ms);
+void journal_log(const char *line);
+void journal_log_record(const su_info_t *rec);
+int journal_scan_record(const char *line, su_info_t *rec);
+void journal_commit(void);
+void journal_close(void);
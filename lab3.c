@@ -18,99 +18,540 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "datatypes.h"
 #include "list.h"
 #include "sas_support.h"
+#include "input.h"
+#include "journal.h"
+#include "output.h"
+#include "server.h"
+#include "shard.h"
+
+// the commands, found by CommandCode
+enum { CMD_NONE, CMD_CREATE, CMD_ADDSU, CMD_LISTCH, CMD_DELSU, CMD_CLEARCH,
+    CMD_CHANGECH, CMD_ASSIGNSU, CMD_ASSIGNBATCH, CMD_PRINTASSIGNED, 
+    CMD_PRINTWAITING, CMD_STATS, CMD_SORT, CMD_ADDTAIL, CMD_QUIT, CMD_SAVE,
+    CMD_LOAD, CMD_PERF };
+
+static const char *command_name[] = { "", "CREATE", "ADDSU", "LISTCH", 
+    "DELSU", "CLEARCH", "CHANGECH", "ASSIGNSU", "ASSIGNBATCH", 
+    "PRINTASSIGNED", "PRINTWAITING", "STATS", "SORT", "ADDTAIL", "QUIT", 
+    "SAVE", "LOAD", "PERF" };
+
+// one switch case for each command and number of fields on the line
+#define CMD(code, items) ((code) << 3 | (items))
+
+// the lists the commands work on, and how to build them again
+typedef struct lab3_state_tag {
+    ListPtr assigned_list;  // sorted, and its size is limited
+    ListPtr waiting_list;   // unsorted, and its size is not limited
+    int sorted_size;
+    int assigned_mode;      // list_construct_mode flags of each list
+    int waiting_mode;
+    int index_channels;     // how sas_index_channels indexes the channels
+    int replaying;          // 1 while the journal is replayed
+    int journaled;          // 1 with -j, when LOAD is refused
+    shard_set_t *shards;    // the lists split into shards, or NULL
+} lab3_state_t;
+
+int CommandCode(const char *command);
+int RunCommand(lab3_state_t *S, const char *line);
+int ServeCommand(void *state, const char *text, int length);
+int CommandLines(void *state, const char *line, int length);
+void ServeIdle(void *state);
 
 int main(int argc, char * argv[])
 {
-    ListPtr assigned_list;
-    ListPtr waiting_list;
+    lab3_state_t state;
     char line[MAXLINE];
-    char command[MAXLINE];
-    char junk[MAXLINE];
-    int num_items;
-    int sorted_size = -1;
-    int input_1 = -1; 
-    int input_2 = -1;
+    int mode = LIST_POOL | LIST_INTRUSIVE | LIST_HASH;
+    int skip = LIST_SKIP;
+    int inbox = 0;
+    const char *journal = NULL;
+    const char *socket_path = NULL;
+    int group_ms = 10;
+    int shard_count = 0;
+    int replayed = 0;
+    int saved_stdout = -1;
+    int fd, null_fd;
+    int i;
 
-    if (argc != 1) {
-        printf("Usage: ./lab2\n");
-        exit(1);
+    // this list should be sorted and the size of the list is limited
+    state.assigned_list = NULL;
+
+    // this list is unsorted and the list size is not limited
+    state.waiting_list = NULL;
+    state.sorted_size = -1;
+    state.index_channels = SAS_INDEX_CHAINS;
+    state.replaying = 0;
+    state.journaled = 0;
+
+    // -m: plain malloc for every node, to benchmark against the pool
+    // -s: records in their own block, separate from the node
+    // -l: linear scans to find a user instead of the hash index
+    // -c: scan the assigned list for a channel instead of its channel index
+    // -v: scan a column of channels with SIMD instead of the channel index
+    // -k: scan the assigned list to insert instead of its skip list
+    // -w: give both lists reader/writer locks, to measure their cost
+    // -q: ADDTAIL pushes on a lock-free inbox of the waiting queue
+    // -j file: replay the journal file, then log each change to it
+    // -g ms: sync the journal at most ms milliseconds after a change
+    // -u path: serve clients on the Unix domain socket path, not stdin
+    // -n shards: split the users by su_id over lists with a thread each
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0) {
+            mode &= ~LIST_POOL;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            mode &= ~LIST_INTRUSIVE;
+        } else if (strcmp(argv[i], "-l") == 0) {
+            mode &= ~LIST_HASH;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            state.index_channels = SAS_INDEX_NONE;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            state.index_channels = SAS_INDEX_COLUMN;
+        } else if (strcmp(argv[i], "-k") == 0) {
+            skip = 0;
+        } else if (strcmp(argv[i], "-w") == 0) {
+            mode |= LIST_LOCKED;
+        } else if (strcmp(argv[i], "-q") == 0) {
+            inbox = LIST_INBOX;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            journal = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            group_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc
+                && atoi(argv[i + 1]) >= 1 && atoi(argv[i + 1]) <= SHARD_MAX) {
+            shard_count = atoi(argv[++i]);
+        } else {
+            printf("Usage: ./lab3 [-m] [-s] [-l] [-c | -v] [-k] [-w] [-q] [-j file [-g ms]] [-u path] [-n shards]\n");
+            exit(1);
+        }
+    }
+    state.assigned_mode = mode | skip;
+    state.waiting_mode = mode | inbox;
+    state.shards = NULL;
+    if (shard_count > 0) {
+        state.shards = shard_start(shard_count, state.assigned_mode,
+                state.waiting_mode, state.index_channels);
     }
     printf("Welcome to lab2. Possible commands:\n");
     printf("CREATE x; ADDSU; DELSU x\nLISTCH x; CLEARCH x; ");
     printf("CHANGECH old new; ASSIGNSU x\nPRINTASSIGNED; PRINTWAITING\n");
-    printf("STATS; SORT x; ADDTAIL su_id; QUIT\n");
-
-    // this list should be sorted and the size of the list is limited
-    assigned_list = NULL;
+    printf("STATS; PERF; SORT x; ADDTAIL su_id; QUIT\n");
 
-    // this list is unsorted and the list size is not limited
-    waiting_list = NULL;
+    // replay the journal first, with its output thrown away
+    if (journal != NULL) {
+        state.journaled = 1;
+        fd = open(journal, O_RDONLY);
+        if (fd >= 0) {
+            input_from(fd);
+            state.replaying = 1;
+            fflush(stdout);
+            saved_stdout = dup(STDOUT_FILENO);
+            null_fd = open("/dev/null", O_WRONLY);
+            if (null_fd < 0) {
+                perror("/dev/null");
+                exit(1);
+            }
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        } else if (journal_open(journal, group_ms) < 0) {
+            perror(journal);
+            exit(1);
+        }
+    }
 
     // main loop to collect user input, call appropriate function for each command
-    // remember fgets includes newline \n unless line too long
-    while (fgets(line, MAXLINE, stdin) != NULL) {
-        num_items = sscanf(line, "%s%d%d%s", command, &input_1, &input_2, junk);
-        if (num_items == 2 && strcmp(command, "CREATE") == 0) {
-            sorted_size = input_1;
-            if (sorted_size < 1) {
-                printf("Cannot create list: invalid size %d\n", sorted_size);
+    // remember input_line includes newline \n unless line too long
+    // a server only reads the journal here, and its clients after the loop
+    while (socket_path == NULL || state.replaying) {
+        // sync logged changes before waiting for more input
+        if (!state.replaying && input_pending() == 0) {
+            journal_commit();
+        }
+        if (!input_line(line, MAXLINE)) {
+            if (!state.replaying) {
+                if (state.shards != NULL) {
+                    shard_stop(state.shards);
+                }
+                journal_close();
+                exit(0);
+            }
+            // end of the journal: back to the user, logging from here on
+            if (state.shards != NULL) {
+                shard_flush(state.shards, 1);
+            }
+            fflush(stdout);
+            close(STDOUT_FILENO);
+            dup2(saved_stdout, STDOUT_FILENO);
+            close(saved_stdout);
+            input_from(STDIN_FILENO);
+            state.replaying = 0;
+            if (journal_open(journal, group_ms) < 0) {
+                perror(journal);
+                exit(1);
+            }
+            printf("Recovered %d commands from %s\n", replayed, journal);
+            continue;
+        }
+        replayed += state.replaying;
+        if (!RunCommand(&state, line)) {
+            if (state.shards != NULL) {
+                shard_stop(state.shards);
+            }
+            sas_cleanup(state.assigned_list);
+            sas_cleanup(state.waiting_list);
+            journal_close();
+            exit(0);
+        }
+        // the replies of the shards are written out once the input runs dry
+        if (state.shards != NULL) {
+            shard_flush(state.shards, input_pending() == 0);
+        }
+    }
+
+    // each client gets the replies to its own commands; QUIT only ends
+    // its connection, and SIGINT or SIGTERM stops the server
+    printf("Serving clients on %s\n", socket_path);
+    fflush(stdout);
+    if (server_run(socket_path, ServeCommand, CommandLines, ServeIdle, &state) < 0) {
+        perror(socket_path);
+        exit(1);
+    }
+    if (state.shards != NULL) {
+        shard_stop(state.shards);
+    }
+    sas_cleanup(state.assigned_list);
+    sas_cleanup(state.waiting_list);
+    journal_close();
+    printf("Server stopped\n");
+    exit(0);
+}
+
+/* Carries out the command on one line of input.  ADDSU reads the lines of
+ * its record with input_line, from wherever the line came from.
+ *
+ * With shards, the command is handed to them and its reply is written
+ * later by shard_flush, in order with the other replies.
+ *
+ * Returns 0 after QUIT, or 1 for any other line.
+ */
+int RunCommand(lab3_state_t *S, const char *line)
+{
+    char command[MAXLINE];
+    char file[MAXLINE];
+    int code;
+    int num_items;
+    int input_1 = -1; 
+    int input_2 = -1;
+    int result = 1;
+    su_info_t rec;
+
+    num_items = input_scan(line, command, &input_1, &input_2);
+    code = (num_items < 1) ? CMD_NONE : CommandCode(command);
+    if (code == CMD_SAVE || code == CMD_LOAD) {
+        // these take a file name instead of numbers
+        num_items = input_scan_word(line, command, file);
+    }
+    if (S->shards != NULL) {
+        shard_begin(S->shards);
+    }
+    switch (CMD(code, num_items)) {
+    case CMD(CMD_CREATE, 2):
+        // logged even when invalid, since the size limit is still changed
+        journal_log(line);
+        S->sorted_size = input_1;
+        if (S->sorted_size < 1) {
+            output_printf("Cannot create list: invalid size %d\n", S->sorted_size);
+        } else {
+            // clean up old list if necessary and create a new empty one
+            output_printf("Assignment list size limit: %d\n", S->sorted_size);
+            if (S->shards != NULL) {
+                shard_create(S->shards);
+                break;
+            }
+            S->assigned_list = sas_create(S->assigned_list, "assignment list",
+                    S->waiting_list, S->assigned_mode);
+            sas_index_channels(S->assigned_list, S->index_channels);
+            S->waiting_list = sas_create(S->waiting_list, "waiting queue",
+                    S->assigned_list, S->waiting_mode);
+        }
+        break;
+    case CMD(CMD_ADDSU, 1):
+        // the prompts are logged as one line with the whole record
+        memset(&rec, 0, sizeof(su_info_t));
+        sas_record_fill(&rec);
+        journal_log_record(&rec);
+        if (S->shards != NULL) {
+            shard_add_rec(S->shards, &rec);
+        } else {
+            sas_add_rec(S->assigned_list, S->sorted_size, S->waiting_list, &rec);
+        }
+        break;
+    case CMD(CMD_ADDSU, 4):
+        // only a journal holds ADDSU with its record on the same line
+        if (S->replaying && journal_scan_record(line, &rec)) {
+            if (S->shards != NULL) {
+                shard_add_rec(S->shards, &rec);
+            } else {
+                sas_add_rec(S->assigned_list, S->sorted_size, S->waiting_list, &rec);
+            }
+        } else {
+            output_printf("# %s", line);
+        }
+        break;
+    case CMD(CMD_LISTCH, 2):
+        if (sas_invalid_ch(input_1)) {
+            output_printf("Invalid channel number %d for LISTCH\n", input_1);
+        } else if (S->shards != NULL) {
+            shard_lookup(S->shards, input_1);
+        } else {
+            sas_lookup(S->assigned_list, input_1);
+        }
+        break;
+    case CMD(CMD_DELSU, 2):
+        journal_log(line);
+        if (S->shards != NULL) {
+            shard_remove(S->shards, input_1);
+        } else {
+            sas_remove(S->assigned_list, S->waiting_list, input_1);
+        }
+        break;
+    case CMD(CMD_CLEARCH, 2):
+        if (sas_invalid_ch(input_1)) {
+            output_printf("Invalid channel number %d for CLEARCH\n", input_1);
+        } else {
+            journal_log(line);
+            if (S->shards != NULL) {
+                shard_move(S->shards, input_1);
             } else {
-                // clean up old list if necessary and create a new empty one
-                printf("Assignment list size limit: %d\n", sorted_size);
-                assigned_list = sas_create(assigned_list, "assignment list");
-                waiting_list = sas_create(waiting_list, "waiting queue");
+                sas_move(S->assigned_list, input_1, S->waiting_list);
             }
-        } else if (num_items == 1 && strcmp(command, "ADDSU") == 0) {
-            sas_add(assigned_list, sorted_size, waiting_list);
-        } else if (num_items == 2 && strcmp(command, "LISTCH") == 0) {
-            if (sas_invalid_ch(input_1)) {
-                printf("Invalid channel number %d for LISTCH\n", input_1);
+        }
+        break;
+    case CMD(CMD_CHANGECH, 3):
+        if (sas_invalid_ch(input_1) || sas_invalid_ch(input_2)) {
+            output_printf("Invalid old %d or new %d channel for CHANGECH\n", 
+                    input_1, input_2);
+        } else {
+            journal_log(line);
+            if (S->shards != NULL) {
+                shard_change(S->shards, input_1, input_2);
             } else {
-                sas_lookup(assigned_list, input_1);
+                sas_change(S->assigned_list, input_1, input_2);
             }
-        } else if (num_items == 2 && strcmp(command, "DELSU") == 0) {
-            sas_remove(assigned_list, waiting_list, input_1);
-        } else if (num_items == 2 && strcmp(command, "CLEARCH") == 0) {
-            if (sas_invalid_ch(input_1)) {
-                printf("Invalid channel number %d for CLEARCH\n", input_1);
+        }
+        break;
+    case CMD(CMD_ASSIGNSU, 2):
+        if (sas_invalid_ch(input_1)) {
+            output_printf("Invalid channel number %d for ASSIGNSU\n", input_1);
+        } else {
+            journal_log(line);
+            if (S->shards != NULL) {
+                shard_assign(S->shards, S->sorted_size, input_1);
             } else {
-                sas_move(assigned_list, input_1, waiting_list);
+                sas_assign(S->assigned_list, S->sorted_size, S->waiting_list, input_1);
             }
-        } else if (num_items == 3 && strcmp(command, "CHANGECH") == 0) {
-            if (sas_invalid_ch(input_1) || sas_invalid_ch(input_2)) {
-                printf("Invalid old %d or new %d channel for CHANGECH\n", 
-                        input_1, input_2);
+        }
+        break;
+    case CMD(CMD_ASSIGNBATCH, 3):
+        if (sas_invalid_ch(input_2)) {
+            output_printf("Invalid channel number %d for ASSIGNBATCH\n", input_2);
+        } else if (input_1 < 1) {
+            output_printf("Invalid batch size %d for ASSIGNBATCH\n", input_1);
+        } else {
+            journal_log(line);
+            if (S->shards != NULL) {
+                shard_assign_batch(S->shards, S->sorted_size, input_2, input_1);
             } else {
-                sas_change(assigned_list, input_1, input_2);
+                sas_assign_batch(S->assigned_list, S->sorted_size, S->waiting_list, 
+                        input_2, input_1);
             }
-        } else if (num_items == 2 && strcmp(command, "ASSIGNSU") == 0) {
-            if (sas_invalid_ch(input_1)) {
-                printf("Invalid channel number %d for ASSIGNSU\n", input_1);
+        }
+        break;
+    case CMD(CMD_PRINTASSIGNED, 1):
+        if (S->shards != NULL) {
+            shard_print(S->shards, 0);
+        } else {
+            sas_print(S->assigned_list, "Assigned List");
+        }
+        break;
+    case CMD(CMD_PRINTWAITING, 1):
+        if (S->shards != NULL) {
+            shard_print(S->shards, 1);
+        } else {
+            sas_print(S->waiting_list, "Waiting Queue");
+        }
+        break;
+    case CMD(CMD_STATS, 1):
+        if (S->shards != NULL) {
+            shard_stats(S->shards, S->sorted_size);
+        } else {
+            sas_stats(S->assigned_list, S->sorted_size, S->waiting_list);
+        }
+        break;
+    case CMD(CMD_PERF, 1):
+        if (S->shards != NULL) {
+            shard_perf(S->shards);
+        } else {
+            sas_perf(S->assigned_list, "Assigned List");
+            sas_perf(S->waiting_list, "Waiting Queue");
+        }
+        break;
+    case CMD(CMD_SORT, 2):
+        journal_log(line);
+        if (S->shards != NULL) {
+            shard_sort(S->shards, input_1, 0);
+        } else {
+            sas_sort(S->waiting_list, input_1, 0);
+        }
+        break;
+    case CMD(CMD_SORT, 3):
+        if (input_2 < 0) {
+            output_printf("Invalid thread count %d for SORT\n", input_2);
+        } else {
+            journal_log(line);
+            if (S->shards != NULL) {
+                shard_sort(S->shards, input_1, input_2);
             } else {
-                sas_assign(assigned_list, sorted_size, waiting_list, input_1);
+                sas_sort(S->waiting_list, input_1, input_2);
             }
-        } else if (num_items == 1 && strcmp(command, "PRINTASSIGNED") == 0) {
-            sas_print(assigned_list, "Assigned List");
-        } else if (num_items == 1 && strcmp(command, "PRINTWAITING") == 0) {
-            sas_print(waiting_list, "Waiting Queue");
-        } else if (num_items == 1 && strcmp(command, "STATS") == 0) {
-            sas_stats(assigned_list, sorted_size, waiting_list);
-        } else if (num_items == 2 && strcmp(command, "SORT") == 0) {
-			  sas_sort(waiting_list, input_1);
-        } else if (num_items == 2 && strcmp(command, "ADDTAIL") == 0) {
-			  sas_addtail(waiting_list, input_1);
-        } else if (num_items == 1 && strcmp(command, "QUIT") == 0) {
-			  sas_cleanup(assigned_list);
-			  sas_cleanup(waiting_list);
-            printf("Goodbye\n");
-            break;
+        }
+        break;
+    case CMD(CMD_ADDTAIL, 2):
+        journal_log(line);
+        if (S->shards != NULL) {
+            shard_addtail(S->shards, input_1);
         } else {
-            printf("# %s", line);
+            sas_addtail(S->waiting_list, input_1);
         }
+        break;
+    case CMD(CMD_SAVE, 2):
+        if (S->shards != NULL) {
+            output_printf("Cannot save %s: not available with shards\n", file);
+        } else {
+            sas_save(S->assigned_list, S->sorted_size, S->waiting_list, file);
+        }
+        break;
+    case CMD(CMD_LOAD, 2):
+        if (S->shards != NULL) {
+            output_printf("Cannot load %s: not available with shards\n", file);
+            break;
+        }
+        // the snapshot is not in the journal, so a replay could not
+        // rebuild the lists it gave
+        if (S->journaled) {
+            output_printf("Cannot load %s: not available with a journal\n", file);
+            break;
+        }
+        input_1 = sas_load(file, &S->assigned_list, &S->waiting_list, 
+                S->assigned_mode, S->waiting_mode, S->index_channels);
+        if (input_1 > 0) {
+            S->sorted_size = input_1;
+        }
+        break;
+    case CMD(CMD_QUIT, 1):
+        output_printf("Goodbye\n");
+        result = 0;
+        break;
+    default:
+        output_printf("# %s", line);
     }
-    exit(0);
+    if (S->shards != NULL) {
+        shard_end(S->shards);
+    }
+    return result;
+}
+
+/* Returns the code of a command word, or CMD_NONE if it is not a command.
+ * The switch on its length and first letter is a perfect hash: only SORT
+ * and SAVE share both, and the second letter tells them apart, so one 
+ * string compare confirms the match.
+ */
+int CommandCode(const char *command)
+{
+    int code = CMD_NONE;
+
+    switch (strlen(command) << 8 | (unsigned char) command[0]) {
+        case 6 << 8 | 'C':  code = CMD_CREATE;        break;
+        case 5 << 8 | 'A':  code = CMD_ADDSU;         break;
+        case 6 << 8 | 'L':  code = CMD_LISTCH;        break;
+        case 5 << 8 | 'D':  code = CMD_DELSU;         break;
+        case 7 << 8 | 'C':  code = CMD_CLEARCH;       break;
+        case 8 << 8 | 'C':  code = CMD_CHANGECH;      break;
+        case 8 << 8 | 'A':  code = CMD_ASSIGNSU;      break;
+        case 11 << 8 | 'A': code = CMD_ASSIGNBATCH;   break;
+        case 13 << 8 | 'P': code = CMD_PRINTASSIGNED; break;
+        case 12 << 8 | 'P': code = CMD_PRINTWAITING;  break;
+        case 5 << 8 | 'S':  code = CMD_STATS;         break;
+        case 4 << 8 | 'S':  code = (command[1] == 'O') ? CMD_SORT : CMD_SAVE; break;
+        case 4 << 8 | 'L':  code = CMD_LOAD;          break;
+        case 7 << 8 | 'A':  code = CMD_ADDTAIL;       break;
+        case 4 << 8 | 'Q':  code = CMD_QUIT;          break;
+        case 4 << 8 | 'P':  code = CMD_PERF;          break;
+    }
+    if (code != CMD_NONE && strcmp(command, command_name[code]) != 0) {
+        code = CMD_NONE;
+    }
+    return code;
+}
+
+/* Server callback: runs the commands in text, which a client sent.  The
+ * server only passes whole commands, so ADDSU finds all of its record.
+ *
+ * Returns 0 if one of them was QUIT, and the rest are not run.
+ */
+int ServeCommand(void *state, const char *text, int length)
+{
+    lab3_state_t *S = (lab3_state_t *) state;
+    char line[MAXLINE];
+    int result = 1;
+
+    input_from_text(text, length);
+    while (result && input_line(line, MAXLINE)) {
+        result = RunCommand(S, line);
+        if (S->shards != NULL) {
+            shard_flush(S->shards, 0);
+        }
+    }
+    // the replies must all be in the output of the client on return
+    if (S->shards != NULL) {
+        shard_flush(S->shards, 1);
+    }
+    return result;
+}
+
+/* Server callback: returns how many lines the command on line takes, 
+ * which is 1 except for ADDSU, which is followed by its record.
+ */
+int CommandLines(void *state, const char *line, int length)
+{
+    char text[MAXLINE];
+    char command[MAXLINE];
+    int input_1, input_2;
+
+    // the first MAXLINE - 1 bytes are what input_line hands out
+    if (length > MAXLINE - 1) {
+        length = MAXLINE - 1;
+    }
+    memcpy(text, line, length);
+    text[length] = '\0';
+    if (input_scan(text, command, &input_1, &input_2) == 1
+            && CommandCode(command) == CMD_ADDSU) {
+        return 1 + SAS_RECORD_LINES;
+    }
+    return 1;
+}
+
+/* Server callback: syncs logged changes before the server waits for more
+ * input, as the loop in main does.
+ */
+void ServeIdle(void *state)
+{
+    journal_commit();
 }
@@ -13,8 +13,21 @@
  * Bugs: None known.
  */
 
+// for the writer preferring reader/writer locks of glibc
+#define _GNU_SOURCE
+
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "datatypes.h"   // defines data_t 
 #include "list.h"        // defines public functions for list ADT 
@@ -23,8 +36,116 @@
 #define SORTED_LIST   0xCACACAC
 #define UNSORTED_LIST 0x3535353
 
+// blocks carved out of each slab by the pool allocator.  Taller skip list
+// towers are rarer, so their slabs hold fewer, down to LIST_SLAB_MIN_BLOCKS
+#define LIST_SLAB_BLOCKS 1024
+#define LIST_SLAB_MIN_BLOCKS 16
+
+// runs sorted by insertion before the bottom-up merge sort merges them
+#define LIST_SORT_RUN 16
+// pending runs of the bottom-up merge sort, one per doubling of the width
+#define LIST_SORT_BINS 32
+// the natural merge sort extends shorter runs to this length by insertion
+#define LIST_MIN_RUN 32
+// pending runs of the natural merge sort; run lengths grow at least like
+// the Fibonacci numbers, so this covers any int list size
+#define LIST_RUN_STACK 64
+
+// the radix sort takes the key apart in digits of this many bits
+#define LIST_RADIX_BITS 8
+#define LIST_RADIX_BUCKETS (1 << LIST_RADIX_BITS)
+
+// the key sort orders blocks of this many keys with a sorting network
+// before merging them
+#define LIST_KEY_BLOCK 8
+// compare-exchange of two packed keys, written so it compiles to
+// conditional moves instead of branches
+#define KEY_SORT2(k, i, j) do { \
+    int64_t lo_ = (k)[i] < (k)[j] ? (k)[i] : (k)[j]; \
+    (k)[j] = (k)[i] < (k)[j] ? (k)[j] : (k)[i]; \
+    (k)[i] = lo_; \
+} while (0)
+
+// the parallel merge sort gives each thread at least this many nodes
+#define LIST_PAR_MIN_NODES 8192
+#define LIST_PAR_MAX_THREADS 256
+
+// the hash index starts with 1 << LIST_HASH_MIN_BITS slots and doubles
+// whenever more than half of them are in use
+#define LIST_HASH_MIN_BITS 6
+
+// the group column starts with this many slots and doubles when full
+#define LIST_COLUMN_MIN 64
+
+// the side table starts with 1 << LIST_SIDE_MIN_BITS slots and doubles
+// whenever more than half of them are in use
+#define LIST_SIDE_MIN_BITS 6
+// home slot of a node in the side table, by multiplicative hashing of its
+// address
+#define SIDE_HOME(L, N) ((unsigned int) \
+    (((uint64_t) (uintptr_t) (N) * 11400714819323198485ull) >> (64 - (L)->side_bits)))
+
+// a node is promoted to each further skip list level with chance 1/4
+#define LIST_SKIP_PROMOTE 4
+
+// operation counters, kept only when built with LIST_PERF defined.  The
+// parallel sort compares on several threads, so the counts add atomically.
+#ifdef LIST_PERF
+#define PERF_COUNT(L, field) \
+    ((void) __atomic_fetch_add(&(L)->perf.field, 1, __ATOMIC_RELAXED))
+#else
+#define PERF_COUNT(L, field) ((void) 0)
+#endif
+#define COMPARE(L, a, b) (PERF_COUNT(L, comparisons), (L)->comp_proc(a, b))
+
+// the list_rec_t block holding an element of a LIST_INTRUSIVE list
+#define REC_OF(elem_ptr) \
+    ((list_rec_t *) ((char *) (elem_ptr) - offsetof(list_rec_t, data)))
+
+// one segment of the parallel merge sort, handed to a worker thread
+typedef struct sort_task_tag {
+    list_t *list;
+    list_node_t *first;    // chain to sort, or the first chain to merge
+    list_node_t *second;   // the chain merged after first
+    list_node_t *result;
+} sort_task_t;
+
+// a sorted run waiting on the stack of the natural merge sort
+typedef struct sort_run_tag {
+    list_node_t *head;
+    list_node_t *tail;
+    int length;
+} sort_run_t;
+
 // prototypes for private functions used in list.c only 
 void list_debug_validate(list_t *L);
+void HashReset(list_t *L, int bits);
+void HashRebuild(list_t *L);
+list_hash_slot_t* HashFind(list_t *L, int key);
+void HashAdd(list_t *L, list_node_t *N);
+void HashRemove(list_t *L, list_node_t *N);
+void SideReset(list_t *L, int bits);
+list_side_t* SideFind(list_t *L, list_node_t *N);
+list_side_t* SideAdd(list_t *L, list_node_t *N);
+void SideRemove(list_t *L, list_node_t *N);
+void GroupAdd(list_t *L, list_node_t *N);
+void GroupRemove(list_t *L, list_node_t *N);
+void GroupRebuild(list_t *L);
+void GroupAppend(list_t *L, list_node_t *N);
+void ColumnAdd(list_t *L, list_node_t *N);
+void ColumnRemove(list_t *L, list_node_t *N);
+void ColumnRebuild(list_t *L);
+int GroupBefore(list_t *L, list_node_t *a, list_node_t *b);
+list_node_t* SkipSearch(list_t *L, data_t *elem_ptr, int after_equal, list_skip_t **update);
+int SkipPasses(list_t *L, list_node_t *N, data_t *elem_ptr, int after_equal);
+list_skip_t* SkipTower(list_t *L, list_node_t *N, list_skip_t **update);
+list_skip_t* SkipLink(list_t *L, list_node_t *N, list_skip_t **update);
+void SkipUnlink(list_t *L, list_node_t *N);
+void SkipClear(list_t *L);
+void SkipRebuild(list_t *L);
+int SkipRandomLevel(list_t *L);
+list_t* ListConstructLike(list_t *L);
+void PerfMerge(list_t *L, list_t *part);
 void InsertionSort(ListPtr list_ptr);
 void SelectionSortR(list_t *A, list_node_t *m, list_node_t *n);
 void SelectionSortI(list_t *A, list_node_t *m, list_node_t *n);
@@ -32,6 +153,36 @@ list_node_t* FindMax(list_t *A, list_node_t *m, list_node_t *n);
 void MergeSort(list_t *List);
 void HalveList(list_t* list_ptr, list_t* rList, list_t* lList);
 void CombineLists (list_t* list_ptr, list_t* rList, list_t* lList);
+void SwapData(list_t *A, list_node_t *x, list_node_t *y);
+void MergeSortRelink(list_t *L);
+list_node_t* SortChain(list_t *L, list_node_t *head);
+list_node_t* MergeChains(list_t *L, list_node_t *a, list_node_t *b);
+void MergeSortBottomUp(list_t *L);
+list_node_t* SortChainBottomUp(list_t *L, list_node_t *head);
+void ParallelMergeSort(list_t *L);
+void* SortSegmentWorker(void *task_ptr);
+void* MergeSegmentsWorker(void *task_ptr);
+list_node_t* CutChain(list_node_t *head, int count);
+list_node_t* InsertionSortChain(list_t *L, list_node_t *head);
+void NaturalMergeSort(list_t *L);
+list_node_t* CutRun(list_t *L, list_node_t *rest, sort_run_t *run);
+void MergeRuns(list_t *L, sort_run_t *a, sort_run_t *b);
+void RadixSort(list_t *L);
+void KeySort(list_t *L);
+void KeySortBlock(int64_t *keys, int count);
+void KeyMerge(const int64_t *a, int a_count, const int64_t *b, int b_count, int64_t *out);
+void RelinkPrev(list_t *L, list_node_t *head);
+list_pool_t* PoolCreate(int mode);
+void PoolRelease(list_pool_t *P);
+void* PoolAlloc(list_pool_t *P, int block_class);
+void PoolFree(list_pool_t *P, int block_class, void *block);
+list_node_t* NodeAlloc(list_t *L, data_t *elem_ptr);
+void NodeFree(list_t *L, list_node_t *N);
+int NodeShared(list_t *A, list_t *B);
+void NodeLink(list_t *list_ptr, list_node_t *newNode, list_node_t *idx_ptr);
+void NodeLinkSorted(list_t *list_ptr, list_node_t *newNode);
+void NodeUnlink(list_t *list_ptr, list_node_t *idx_ptr);
+list_node_t* NodeMove(list_t *dest_ptr, list_t *src_ptr, list_node_t *N);
 
 /* ----- below are the functions  ----- */
 
@@ -48,6 +199,51 @@ void CombineLists (list_t* list_ptr, list_t* rList, list_t* lList);
  * and the header block.
  */
 list_t *list_construct(int (*fcomp)(const data_t *, const data_t *))
+{
+    return list_construct_mode(fcomp, NULL, LIST_MALLOC, NULL);
+}
+
+/* Allocates a new, empty list with the allocator and indexes selected by
+ * mode.
+ *
+ * fkey: optional, may be NULL.  Maps an element to an integer key that
+ *       orders elements exactly as fcomp does: fkey(A) < fkey(B) when
+ *       fcomp(A, B) is 1, and equal keys when fcomp returns 0.  The radix
+ *       sort needs it, so the list never has to look inside a data_t.
+ *
+ * mode: LIST_MALLOC gives every node its own malloc and free.
+ *       LIST_POOL carves nodes and records out of large slabs and recycles
+ *       them through a free list, so the steady state does not call malloc
+ *       at all.
+ *       Either may be or'ed with LIST_INTRUSIVE, which places the record
+ *       inside its node.  One block then holds both, the record is next to
+ *       the links during a scan, and moving a record from one list to
+ *       another allocates nothing.  Records for such a list must come from
+ *       list_elem_alloc.
+ *       LIST_HASH keeps a hash index from key to node, so list_elem_find
+ *       takes O(1) instead of a scan.  It needs fkey, and the key of an
+ *       element must not change while the element is in the list.
+ *       LIST_SKIP keeps skip list levels over the list while it is sorted,
+ *       so list_insert_sorted and list_elem_find take expected O(log n).
+ *       The levels are dropped by list_insert and built again by list_sort.
+ *       They are towers kept apart from the nodes, carved from a pool of
+ *       their own that is freed as a whole when the levels are dropped, so
+ *       the nodes stay small.  Removing an element searches for its tower,
+ *       in expected O(log n).
+ *       LIST_LOCKED gives the list a reader/writer lock for list_lock, so
+ *       several threads can use it, and makes its pool thread safe.
+ *       LIST_INBOX lets any thread add elements at the tail with list_push,
+ *       without a lock, for one consumer to link in with list_drain.  It 
+ *       also makes the pool thread safe, so producers can list_elem_alloc.
+ *
+ * peer_ptr: if not NULL and both lists use LIST_POOL, the new list shares
+ *           the pool of peer_ptr.  The allocation flags of the two modes 
+ *           must match.  Records may only be moved between lists that share
+ *           an allocator.  The slabs are released when the last list using
+ *           the pool is destructed.
+ */
+list_t *list_construct_mode(int (*fcomp)(const data_t *, const data_t *),
+        int (*fkey)(const data_t *), int mode, list_t *peer_ptr)
 {
     list_t *L;
 
@@ -57,12 +253,82 @@ list_t *list_construct(int (*fcomp)(const data_t *, const data_t *))
     L->current_list_size = 0;
     L->list_sorted_state = SORTED_LIST;
 	 L->comp_proc = fcomp;
+	 L->key_proc = fkey;
+	 L->mode = mode;
+	 L->sort_threads = 0;
+	 L->pool = NULL;
+	 L->hash_table = NULL;
+	 L->hash_bits = 0;
+	 L->hash_keys = 0;
+	 L->group_proc = NULL;
+	 L->group_count = 0;
+	 L->group_head = NULL;
+	 L->group_tail = NULL;
+	 L->group_size = NULL;
+	 L->side_table = NULL;
+	 L->side_bits = 0;
+	 L->side_used = 0;
+	 L->column_proc = NULL;
+	 L->column = NULL;
+	 L->column_node = NULL;
+	 L->column_len = 0;
+	 L->column_cap = 0;
+	 L->column_dirty = 0;
+	 L->column_groups = 0;
+	 L->column_match = NULL;
+	 L->column_match_cap = 0;
+	 L->skip_levels = (mode & LIST_SKIP) ? 1 : 0;
+	 L->skip_seed = 2463534242u;
+	 L->skip_pool = NULL;
+	 L->inbox = NULL;
+	 L->inbox_count = 0;
+#ifdef LIST_PERF
+	 memset(&L->perf, 0, sizeof(list_perf_t));
+#endif
+	 if (mode & LIST_HASH) {
+		 assert(fkey != NULL);
+		 HashReset(L, LIST_HASH_MIN_BITS);
+	 }
+	 if (mode & LIST_POOL) {
+		 if (peer_ptr != NULL && peer_ptr->pool != NULL) {
+			 assert((peer_ptr->mode & LIST_ALLOC_FLAGS) == (mode & LIST_ALLOC_FLAGS));
+			 L->pool = peer_ptr->pool;
+			 L->pool->ref_count++;
+			 if (mode & (LIST_LOCKED | LIST_INBOX)) {
+				 L->pool->locked = 1;
+			 }
+		 }
+		 else {
+			 L->pool = PoolCreate(mode);
+		 }
+	 }
+	 if (mode & LIST_LOCKED) {
+		 // writers go first, so a stream of readers cannot starve them
+		 pthread_rwlockattr_t attr;
+		 pthread_rwlockattr_init(&attr);
+#ifdef __GLIBC__
+		 pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+		 pthread_rwlock_init(&L->lock, &attr);
+		 pthread_rwlockattr_destroy(&attr);
+	 }
 
     // the last line of this function must call validate
     // list_debug_validate(L);
     return L;
 }
 
+/* Purpose: tell if the list is in sorted order.
+ *
+ * Return: 1 if the list is sorted, so list_insert_sorted may be used on it,
+ * or 0 if list_insert has put it out of order since it was last sorted.
+ */
+int list_is_sorted(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+    return list_ptr->list_sorted_state == SORTED_LIST;
+}
+
 /* Purpose: return the count of number of elements in the list.
  *
  * list_ptr: pointer to list-of-interest.  
@@ -76,34 +342,240 @@ int list_size(list_t *list_ptr)
     return list_ptr->current_list_size;
 }
 
+/* Purpose: lock a LIST_LOCKED list, waiting until the lock is free.
+ *
+ * how: LIST_READ to share the list with other readers, for functions that
+ *      do not change it (list_elem_find, list_access, the iterators,
+ *      list_size and the group functions), or LIST_WRITE for sole use.
+ *
+ * The functions of list.c never lock on their own, so a caller holds the 
+ * lock for as long as it keeps iterators into the list.  A thread that 
+ * needs two lists takes them together with list_lock_pair.  Nothing is
+ * done for a list without LIST_LOCKED.
+ */
+void list_lock(list_t *list_ptr, int how)
+{
+    assert(NULL != list_ptr);
+	 if (!(list_ptr->mode & LIST_LOCKED)) {
+		 return;
+	 }
+	 if (how == LIST_WRITE) {
+		 pthread_rwlock_wrlock(&list_ptr->lock);
+	 }
+	 else {
+		 pthread_rwlock_rdlock(&list_ptr->lock);
+	 }
+}
+
+/* Purpose: release the lock taken by list_lock.
+ */
+void list_unlock(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+	 if (list_ptr->mode & LIST_LOCKED) {
+		 pthread_rwlock_unlock(&list_ptr->lock);
+	 }
+}
+
+/* Purpose: lock two lists the same way, for an operation that uses both.
+ *
+ * The list at the lower address is always locked first, so two threads
+ * locking the same pair in either order cannot deadlock.  Release them 
+ * with list_unlock_pair.
+ */
+void list_lock_pair(list_t *a_ptr, list_t *b_ptr, int how)
+{
+    assert(NULL != a_ptr && NULL != b_ptr);
+	 if (a_ptr == b_ptr) {
+		 list_lock(a_ptr, how);
+	 }
+	 else if ((uintptr_t) a_ptr < (uintptr_t) b_ptr) {
+		 list_lock(a_ptr, how);
+		 list_lock(b_ptr, how);
+	 }
+	 else {
+		 list_lock(b_ptr, how);
+		 list_lock(a_ptr, how);
+	 }
+}
+
+/* Purpose: release the locks taken by list_lock_pair.
+ */
+void list_unlock_pair(list_t *a_ptr, list_t *b_ptr)
+{
+	 list_unlock(a_ptr);
+	 if (a_ptr != b_ptr) {
+		 list_unlock(b_ptr);
+	 }
+}
+
+/* Purpose: add an element at the tail of a LIST_INBOX list, from any thread.
+ *
+ * The node is pushed on the inbox of the list with a compare and swap, so
+ * producers take no lock and never wait for the consumer.  Only the pool,
+ * if the list has one, is used under its mutex.  The element joins the 
+ * list at the next list_drain, after every element pushed before it; 
+ * until then the other functions of list.c do not see it.
+ *
+ * Return: 1 if the element was pushed, or 0 if the list is not a LIST_INBOX
+ * list.  Nothing is done then, and the caller should list_insert it.
+ */
+int list_push(list_t *list_ptr, data_t *elem_ptr)
+{
+	 list_node_t *N;
+
+    assert(NULL != list_ptr && NULL != elem_ptr);
+	 if (!(list_ptr->mode & LIST_INBOX)) {
+		 return 0;
+	 }
+	 N = NodeAlloc(list_ptr, elem_ptr);
+	 N->prev = NULL;
+	 // counted first, so list_pending is never short of the inbox
+	 __atomic_add_fetch(&list_ptr->inbox_count, 1, __ATOMIC_RELAXED);
+	 N->next = __atomic_load_n(&list_ptr->inbox, __ATOMIC_RELAXED);
+	 while (!__atomic_compare_exchange_n(&list_ptr->inbox, &N->next, N, 1,
+				 __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+		 // a failed swap loaded the new top into N->next, so just retry
+	 }
+	 return 1;
+}
+
+/* Purpose: link every element pushed with list_push at the tail of the
+ * list, in the order they were pushed, as list_insert would.
+ *
+ * The whole inbox is taken with one atomic exchange, so the consumer 
+ * gets each batch of pushes at once while producers keep pushing into a 
+ * new inbox.  This changes the list: call it from the consuming thread,
+ * with LIST_WRITE if the list is also LIST_LOCKED.
+ *
+ * Return: the number of elements linked.
+ */
+int list_drain(list_t *list_ptr)
+{
+	 list_node_t *N, *next;
+	 list_node_t *batch = NULL;
+	 int count = 0;
+
+    assert(NULL != list_ptr);
+	 if (__atomic_load_n(&list_ptr->inbox, __ATOMIC_RELAXED) == NULL) {
+		 return 0;
+	 }
+	 N = __atomic_exchange_n(&list_ptr->inbox, NULL, __ATOMIC_ACQUIRE);
+
+	 // the inbox is newest first, so reverse it into push order
+	 while (N != NULL) {
+		 next = N->next;
+		 N->next = batch;
+		 batch = N;
+		 N = next;
+		 count++;
+	 }
+	 for (N = batch; N != NULL; N = next) {
+		 next = N->next;
+		 NodeLink(list_ptr, N, NULL);
+	 }
+	 __atomic_sub_fetch(&list_ptr->inbox_count, count, __ATOMIC_RELAXED);
+	 return count;
+}
+
+/* Purpose: return the number of elements pushed but not yet drained.
+ *
+ * The count may be read without a lock.  A push in progress is already
+ * counted, so a count above 0 means list_drain is worth calling.
+ */
+int list_pending(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+	 return __atomic_load_n(&list_ptr->inbox_count, __ATOMIC_RELAXED);
+}
+
+/* Purpose: copy out the operation counters of the list.
+ *
+ * perf_ptr: filled with the counts since the list was constructed or
+ *           list_perf_reset was last called, or with zeros.
+ *
+ * Return: 1 if the counters are kept, or 0 if list.c was compiled without
+ * LIST_PERF and *perf_ptr is all zeros.
+ */
+int list_perf_read(list_t *list_ptr, list_perf_t *perf_ptr)
+{
+    assert(NULL != list_ptr);
+#ifdef LIST_PERF
+	 memcpy(perf_ptr, &list_ptr->perf, sizeof(list_perf_t));
+	 return 1;
+#else
+	 memset(perf_ptr, 0, sizeof(list_perf_t));
+	 return 0;
+#endif
+}
+
+/* Purpose: set the operation counters of the list back to zero.
+ */
+void list_perf_reset(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+#ifdef LIST_PERF
+	 memset(&list_ptr->perf, 0, sizeof(list_perf_t));
+#endif
+}
+
 /* Deallocates the contents of the specified list, releasing associated memory
  * resources for other purposes.
  *
  * Free all elements in the list and the header block.
+ *
+ * When this is the last list using a pool, the nodes and records are not
+ * visited one at a time; the slabs holding them are released as a whole.
  */
 void list_destruct(list_t *list_ptr)
 {
     // the first line must validate the list 
     // list_debug_validate(list_ptr);
 	 
-	 IteratorPtr currentNode = list_ptr->head;
+	 IteratorPtr currentNode = NULL;
 	 IteratorPtr nextNode = NULL;
+	 data_t *currentData = NULL;
+
+	 list_drain(list_ptr); // pushed elements are freed with the rest
+	 currentNode = list_ptr->head;
+	 SkipClear(list_ptr); // the towers go with their own pool
+	 if (list_ptr->pool != NULL && list_ptr->pool->ref_count == 1) {
+		 currentNode = NULL; // every block lives in a slab freed below
+	 }
 
 	 while (currentNode != NULL) {
 		 nextNode = currentNode->next;
-
-		 // get rid of the data
-		 free(currentNode->data_ptr);
-		 currentNode->data_ptr = NULL;
+		 currentData = currentNode->data_ptr;
 
 		 // get rid of the node
-		 free(currentNode);
+		 NodeFree(list_ptr, currentNode);
 		 currentNode = NULL;
 
+		 // get rid of the data (and an intrusive node with it)
+		 list_elem_free(list_ptr, currentData);
+		 currentData = NULL;
+
 		 // move to next node to free
 		 currentNode = nextNode;
 	 }
 
+	 if (list_ptr->pool != NULL) {
+		 PoolRelease(list_ptr->pool);
+		 list_ptr->pool = NULL;
+	 }
+	 free(list_ptr->hash_table);
+	 list_ptr->hash_table = NULL;
+	 free(list_ptr->group_head);
+	 free(list_ptr->group_tail);
+	 free(list_ptr->group_size);
+	 free(list_ptr->side_table);
+	 free(list_ptr->column);
+	 free(list_ptr->column_node);
+	 free(list_ptr->column_match);
+	 if (list_ptr->mode & LIST_LOCKED) {
+		 pthread_rwlock_destroy(&list_ptr->lock);
+	 }
+
 	 // get rid of header
 	 free(list_ptr);
 	 list_ptr = NULL;
@@ -156,6 +628,9 @@ list_node_t * list_iter_next(list_node_t * idx_ptr)
  *
  * Note: to get a pointer to the matching data_t memory block pass the return
  *       value from this function to the list_access function.
+ *
+ * A LIST_HASH list answers from its index.  Only a key held by more than
+ * one element needs the scan, to find the first of them.
  */
 list_node_t * list_elem_find(list_t *list_ptr, data_t *elem_ptr)
 {
@@ -163,9 +638,30 @@ list_node_t * list_elem_find(list_t *list_ptr, data_t *elem_ptr)
 
 	 IteratorPtr N = list_ptr->head;
 
+	 if (list_ptr->hash_table != NULL) {
+		 list_hash_slot_t *slot = HashFind(list_ptr, list_ptr->key_proc(elem_ptr));
+		 if (slot->count == 0) {
+			 return NULL;
+		 }
+		 if (slot->node != NULL) {
+			 return slot->node;
+		 }
+	 }
+	 if (list_ptr->skip_levels > 0) {
+		 // N becomes the first element that does not rank before elem_ptr
+		 N = SkipSearch(list_ptr, elem_ptr, 0, NULL);
+		 N = (N == NULL) ? list_ptr->head : N->next;
+		 PERF_COUNT(list_ptr, find_visits);
+		 if (N != NULL && COMPARE(list_ptr, N->data_ptr, elem_ptr) == 0) {
+			 return N;
+		 }
+		 return NULL;
+	 }
+
 	 // look for match until end of list reached
 	 while (N != NULL) {
-		 if (list_ptr->comp_proc(N->data_ptr, elem_ptr) == 0) {
+		 PERF_COUNT(list_ptr, find_visits);
+		 if (COMPARE(list_ptr, N->data_ptr, elem_ptr) == 0) {
 			 return N;
 		 }
 		 N = N->next;
@@ -201,6 +697,9 @@ list_node_t * list_elem_find(list_t *list_ptr, data_t *elem_ptr)
  * Note: if the element to be inserted is equal in rank to an element already
  * in the list, the newly inserted element will be placed after all the
  * elements of equal rank that are already in the list.
+ *
+ * A LIST_SKIP list finds the position through its skip list levels in 
+ * expected O(log n) instead of scanning from the head.
  */
 void list_insert_sorted(list_t *list_ptr, data_t *elem_ptr)
 {
@@ -208,139 +707,509 @@ void list_insert_sorted(list_t *list_ptr, data_t *elem_ptr)
     assert(SORTED_LIST == list_ptr->list_sorted_state);
 
 	 // create a new node for the data
-	 IteratorPtr newNode = (IteratorPtr) malloc(sizeof(list_node_t));
-	 newNode->data_ptr = elem_ptr;
-	 newNode->next = NULL;
-	 newNode->prev = NULL;
+	 NodeLinkSorted(list_ptr, NodeAlloc(list_ptr, elem_ptr));
+}
 
-	 // if list empty, need to assign this as head and tail.
-	 if (list_ptr->current_list_size == 0) {
-		 list_ptr->head = newNode;
-		 list_ptr->tail = newNode;
-		 list_ptr->current_list_size++;
-		 
-		 // list_debug_validate(list_ptr);
+/* Moves the first count elements of one list into a sorted list, keeping
+ * it sorted.
+ *
+ * dest_ptr: the sorted list to merge into
+ * src_ptr:  the list the elements are taken from, in any order
+ * count:    how many elements to take from the head of src_ptr.  If 
+ *           src_ptr is shorter, all of its elements are taken.
+ *
+ * The taken elements are cut off src_ptr, sorted with the bottom-up merge
+ * sort and then merged into dest_ptr in one pass, which stops as soon as
+ * the last one is placed.  The result is the same as calling 
+ * list_insert_sorted for each element in turn: an element goes after the
+ * elements of equal rank already in dest_ptr, and taken elements of equal
+ * rank keep their order.  Nodes move to dest_ptr as they are when the two
+ * lists share an allocator (see peer_ptr of list_construct_mode).
+ */
+void list_merge_sorted(list_t *dest_ptr, list_t *src_ptr, int count)
+{
+	 list_skip_t *last[LIST_SKIP_LEVELS] = { NULL };
+	 list_skip_t *T, *tower;
+	 list_node_t *batch, *N, *old, *prev, *added;
+	 int moved, lvl;
+
+    assert(NULL != dest_ptr && NULL != src_ptr && dest_ptr != src_ptr);
+    assert(SORTED_LIST == dest_ptr->list_sorted_state);
+	 if (count > src_ptr->current_list_size) {
+		 count = src_ptr->current_list_size;
+	 }
+	 if (count < 1) {
 		 return;
 	 }
 
-	 IteratorPtr N = list_ptr->head;
-	 int result = 0; // for value of comp_proc
-	 int inserted = 0; // 0 for not inserted, 1 for inserted
+	 // cut the first count nodes off src_ptr, out of each of its indexes
+	 batch = src_ptr->head;
+	 N = batch;
+	 for (moved = 0; moved < count; moved++) {
+		 if (src_ptr->hash_table != NULL) {
+			 HashRemove(src_ptr, N);
+		 }
+		 if (src_ptr->group_count > 0) {
+			 GroupRemove(src_ptr, N);
+		 }
+		 if (src_ptr->column != NULL) {
+			 ColumnRemove(src_ptr, N);
+		 }
+		 if (src_ptr->skip_levels > 0) {
+			 SkipUnlink(src_ptr, N);
+		 }
+		 if (src_ptr->side_table != NULL) {
+			 SideRemove(src_ptr, N);
+		 }
+		 prev = N;
+		 N = N->next;
+	 }
+	 prev->next = NULL;
+	 src_ptr->head = N;
+	 if (N == NULL) {
+		 src_ptr->tail = NULL;
+	 }
+	 else {
+		 N->prev = NULL;
+	 }
+	 src_ptr->current_list_size -= count;
 
-	 while (N != NULL) {
-		 result = list_ptr->comp_proc(elem_ptr, N->data_ptr);
-		 if (result == 1) { // put it before N
-			 if (N == list_ptr->head) {
-				 newNode->next = N;
-				 N->prev = newNode;
-				 list_ptr->head = newNode;
-				 N = NULL; // make loop end
+	 if (!NodeShared(dest_ptr, src_ptr)) {
+		 // give each element a node from the allocator of dest_ptr
+		 list_node_t front; // only front.next is used
+		 prev = &front;
+		 for (N = batch; N != NULL; N = old) {
+			 old = N->next;
+			 prev->next = NodeMove(dest_ptr, src_ptr, N);
+			 prev = prev->next;
+		 }
+		 prev->next = NULL;
+		 batch = front.next;
+	 }
+	 batch = SortChainBottomUp(dest_ptr, batch);
+
+	 // walk dest_ptr once, linking each new node in front of the first
+	 // node that ranks after it.  last[lvl] is the last tower passed on each
+	 // skip list level and tower the next one on level 1, and added chains
+	 // the new nodes through group_next until they are filed in their groups
+	 prev = NULL;
+	 old = dest_ptr->head;
+	 added = NULL;
+	 tower = (dest_ptr->skip_levels > 1) ? dest_ptr->skip_head[1] : NULL;
+	 while (batch != NULL) {
+		 T = NULL;
+		 if (old != NULL && COMPARE(dest_ptr, batch->data_ptr, old->data_ptr) != 1) {
+			 N = old;
+			 old = old->next;
+			 if (tower != NULL && tower->node == N) {
+				 T = tower;
+				 tower = tower->next[0];
+			 }
+		 }
+		 else {
+			 N = batch;
+			 batch = batch->next;
+			 N->prev = prev;
+			 N->next = old;
+			 if (prev == NULL) {
+				 dest_ptr->head = N;
 			 }
 			 else {
-				 newNode->next = N;
-				 newNode->prev = N->prev;
-				 N->prev->next = newNode;
-				 N->prev = newNode;
-				 N = NULL; // make loop end
+				 prev->next = N;
+			 }
+			 if (old == NULL) {
+				 dest_ptr->tail = N;
+			 }
+			 else {
+				 old->prev = N;
+			 }
+			 dest_ptr->current_list_size++;
+			 if (dest_ptr->hash_table != NULL) {
+				 HashAdd(dest_ptr, N);
+			 }
+			 if (dest_ptr->skip_levels > 0) {
+				 T = SkipLink(dest_ptr, N, last);
+			 }
+			 if (dest_ptr->side_table != NULL) {
+				 // a new slot has group -1, which matches no group while the
+				 // chains are fixed
+				 SideAdd(dest_ptr, N)->group_next = added;
+				 added = N;
 			 }
-			 inserted = 1;
-		 }
-		 if (result == -1) { // keep looking through list
-			 N = N->next;
 		 }
-		 if (result == 0) {
-			 N = N->next; // so it will go after entries of equal rank
+		 for (lvl = 1; T != NULL && lvl < T->level; lvl++) {
+			 last[lvl] = T;
 		 }
+		 prev = N;
 	 }
 
-	 if (inserted == 0) { // was not inserted, so put at back
-		 list_ptr->tail->next = newNode;
-		 newNode->prev = list_ptr->tail;
-		 list_ptr->tail = newNode;
+	 if (dest_ptr->group_count > 0) {
+		 for (N = added; N != NULL; N = old) {
+			 old = SideFind(dest_ptr, N)->group_next;
+			 GroupAdd(dest_ptr, N);
+		 }
 	 }
+	 dest_ptr->column_dirty = 1;
 
-	 list_ptr->current_list_size++;
-
-    // list_debug_validate(list_ptr);
+    // list_debug_validate(dest_ptr);
+    // list_debug_validate(src_ptr);
 }
 
-/* Inserts the data element into the list in front of the iterator 
- * position.
- *
- * list_ptr: pointer to list-of-interest.  
+/* Appends copies of an array of elements to the tail of a list, in one
+ * pass.
  *
- * elem_ptr: pointer to the memory block to be inserted into list.
- *
- * idx_ptr: pointer to a list_node_t.  The element is to be inserted as a 
- *          member in the list at the position that is immediately in front 
- *          of the position of the provided Iterator pointer.
- *
- *          If the idx_ptr pointer is NULL, the the new memory block is
- *          inserted after the last element in the list.  That is, a null
- *          iterator pointer means make the element the new tail.
- *
- * If idx_ptr is set using 
- *    -- list_iter_front, then the new element becomes the first item in 
- *       the list.
- *    -- list_iter_back, then the new element is inserted before the last item 
- *       in the list.
- *    -- for any other idx_ptr, the new element is insert before the 
- *       Iterator
- *
- * For example, to insert at the tail of the list do
- *      list_insert(mylist, myelem, NULL)
- * to insert at the front of the list do
- *      list_insert(mylist, myelem, list_iter_front(mylist))
+ * list_ptr:   the list to append to
+ * elem_array: count elements, each copied into a record obtained as with
+ *             list_elem_alloc
+ * count:      number of elements in elem_array
+ * sorted:     1 if the list is to stay sorted, 0 to leave it unsorted
+ *             even if the elements happen to be in order
  *
- * Note that use of this function results in the list to be marked as unsorted,
- * even if the element has been inserted in the correct position.  That is, on
- * completion of this subroutine the list_ptr->list_sorted_state must be equal 
- * to UNSORTED_LIST.
+ * Records and nodes come one after another from the slabs of a LIST_POOL
+ * list, so a large array is laid out in order in memory.  The indexes are
+ * filled once at the end: the hash index of a list that was empty is built
+ * at its final size instead of growing.  With sorted 1 the list stays 
+ * sorted if it was sorted and the elements continue its order, which is
+ * checked on the way.
  */
-void list_insert(list_t *list_ptr, data_t *elem_ptr, list_node_t * idx_ptr)
+void list_append_bulk(list_t *list_ptr, const data_t *elem_array, int count, int sorted)
 {
-    assert(NULL != list_ptr);
-
-	// make new node for the data
-	 IteratorPtr newNode = (IteratorPtr) malloc(sizeof(list_node_t));
-	 newNode->next = NULL;
-	 newNode->prev = NULL;
-	 newNode->data_ptr = elem_ptr;
+	 list_node_t *prev = list_ptr->tail;
+	 list_node_t *first = NULL;
+	 list_node_t *N;
+	 data_t *elem_ptr;
+	 int was_empty = (list_ptr->current_list_size == 0);
+	 int in_order;
+	 int i;
 
-	// if list empty, new node both head and tail
-	 if (list_ptr->current_list_size == 0) {
-		 list_ptr->head = newNode;
-		 list_ptr->tail = newNode;
+    assert(NULL != list_ptr && count >= 0);
+	 if (!sorted && list_ptr->list_sorted_state == SORTED_LIST) {
+		 if (list_ptr->skip_levels > 0) {
+			 SkipClear(list_ptr); // the skip list only works on a sorted list
+		 }
+		 list_ptr->list_sorted_state = UNSORTED_LIST;
 	 }
-	 // want it in back of list
-	 else if (idx_ptr == NULL) { 
-		 list_ptr->tail->next = newNode;
-		 newNode->prev = list_ptr->tail;
-		 list_ptr->tail = newNode; 
+	 in_order = (list_ptr->list_sorted_state == SORTED_LIST);
+	 if (count == 0) {
+		 return;
 	 }
-		 // want it before idx_ptr
-	 else { 
-		 newNode->prev = idx_ptr->prev;
-		 newNode->next = idx_ptr;
-		 idx_ptr->prev = newNode;
-		 if (idx_ptr == list_ptr->head) {
-			 list_ptr->head = newNode;
+	 if (list_ptr->skip_levels > 0) {
+		 SkipClear(list_ptr); // built again below if still sorted
+	 }
+	 for (i = 0; i < count; i++) {
+		 elem_ptr = list_elem_alloc(list_ptr);
+		 *elem_ptr = elem_array[i];
+		 N = NodeAlloc(list_ptr, elem_ptr);
+		 N->prev = prev;
+		 N->next = NULL;
+		 if (prev == NULL) {
+			 list_ptr->head = N;
 		 }
-		 // this may cause issues if idx_ptr is head, so it is put here
 		 else {
-			 newNode->prev->next = newNode;
+			 if (in_order && COMPARE(list_ptr, prev->data_ptr, elem_ptr) == -1) {
+				 in_order = 0;
+			 }
+			 prev->next = N;
 		 }
+		 if (first == NULL) {
+			 first = N;
+		 }
+		 prev = N;
 	 }
-	 list_ptr->current_list_size++;
+	 list_ptr->tail = prev;
+	 list_ptr->current_list_size += count;
 
-    // the last two lines of this function must be the following 
-    if (list_ptr->list_sorted_state == SORTED_LIST) 
-	list_ptr->list_sorted_state = UNSORTED_LIST;
-    // list_debug_validate(list_ptr);
-}
-
-/* Sorts the given list using the specified algorithm.
- * 
+	 if (list_ptr->hash_table != NULL) {
+		 if (was_empty) {
+			 HashRebuild(list_ptr);
+		 }
+		 else {
+			 for (N = first; N != NULL; N = N->next) {
+				 HashAdd(list_ptr, N);
+			 }
+		 }
+	 }
+	 if (list_ptr->side_table != NULL) {
+		 for (N = first; N != NULL; N = N->next) {
+			 SideAdd(list_ptr, N);
+			 if (list_ptr->group_count > 0) {
+				 GroupAppend(list_ptr, N);
+			 }
+		 }
+	 }
+	 list_ptr->column_dirty = 1;
+	 if (!in_order) {
+		 list_ptr->list_sorted_state = UNSORTED_LIST;
+	 }
+	 else if (list_ptr->mode & LIST_SKIP) {
+		 SkipRebuild(list_ptr);
+	 }
+
+    // list_debug_validate(list_ptr);
+}
+
+/* Moves one element from a list into another list in front of an 
+ * iterator, like list_remove followed by list_insert.
+ *
+ * dest_ptr: the list the element moves to
+ * dest_idx: the element is placed in front of this position of dest_ptr,
+ *           or at the tail of dest_ptr if dest_idx is NULL
+ * src_ptr:  the list the element is taken from
+ * src_idx:  position of the element in src_ptr, or NULL for its head.  
+ *           Like with list_remove, this iterator is not valid afterwards.
+ *
+ * When the two lists share an allocator the node itself moves, so nothing
+ * is allocated or freed.  Nothing happens if src_ptr is empty.
+ */
+void list_transfer(list_t *dest_ptr, list_node_t *dest_idx, list_t *src_ptr, list_node_t *src_idx)
+{
+    assert(NULL != dest_ptr && NULL != src_ptr);
+	 if (src_ptr->current_list_size == 0) {
+		 assert(src_idx == NULL);
+		 return;
+	 }
+	 if (src_idx == NULL) {
+		 src_idx = src_ptr->head;
+	 }
+	 NodeUnlink(src_ptr, src_idx);
+	 NodeLink(dest_ptr, NodeMove(dest_ptr, src_ptr, src_idx), dest_idx);
+}
+
+/* Moves one element from a list into its sorted place in a sorted list,
+ * like list_remove followed by list_insert_sorted.  The arguments are the
+ * same as for list_transfer, and again the node itself moves when the two
+ * lists share an allocator.
+ */
+void list_transfer_sorted(list_t *dest_ptr, list_t *src_ptr, list_node_t *src_idx)
+{
+    assert(NULL != dest_ptr && NULL != src_ptr);
+    assert(SORTED_LIST == dest_ptr->list_sorted_state);
+	 if (src_ptr->current_list_size == 0) {
+		 assert(src_idx == NULL);
+		 return;
+	 }
+	 if (src_idx == NULL) {
+		 src_idx = src_ptr->head;
+	 }
+	 NodeUnlink(src_ptr, src_idx);
+	 NodeLinkSorted(dest_ptr, NodeMove(dest_ptr, src_ptr, src_idx));
+}
+
+/* Moves every element of src_ptr to the tail of dest_ptr, keeping their 
+ * order, and leaves src_ptr empty.
+ *
+ * The two chains are joined in O(1) when the lists share an allocator.
+ * Only the indexes cost time in the number of elements moved: each one is
+ * filed in the hash index and channel groups of dest_ptr, if it has them.
+ * Like list_insert, this leaves dest_ptr unsorted unless it was empty.
+ */
+void list_splice(list_t *dest_ptr, list_t *src_ptr)
+{
+	 list_node_t *first = src_ptr->head;
+	 list_node_t *N;
+	 int g;
+
+    assert(NULL != dest_ptr && NULL != src_ptr && dest_ptr != src_ptr);
+	 if (src_ptr->current_list_size == 0) {
+		 return;
+	 }
+	 if (!NodeShared(dest_ptr, src_ptr)) {
+		 while (src_ptr->head != NULL) {
+			 list_transfer(dest_ptr, NULL, src_ptr, NULL);
+		 }
+		 return;
+	 }
+
+	 // empty the indexes of src_ptr without visiting its elements
+	 if (src_ptr->skip_levels > 0) {
+		 SkipClear(src_ptr);
+	 }
+	 if (src_ptr->hash_table != NULL) {
+		 memset(src_ptr->hash_table, 0, 
+				 ((size_t) 1 << src_ptr->hash_bits) * sizeof(list_hash_slot_t));
+		 src_ptr->hash_keys = 0;
+	 }
+	 if (src_ptr->side_table != NULL) {
+		 memset(src_ptr->side_table, 0, 
+				 ((size_t) 1 << src_ptr->side_bits) * sizeof(list_side_t));
+		 src_ptr->side_used = 0;
+	 }
+	 for (g = 0; g < src_ptr->group_count; g++) {
+		 src_ptr->group_head[g] = NULL;
+		 src_ptr->group_tail[g] = NULL;
+		 src_ptr->group_size[g] = 0;
+	 }
+	 src_ptr->column_len = 0;
+	 src_ptr->column_dirty = 0;
+
+	 if (dest_ptr->current_list_size == 0) {
+		 dest_ptr->head = first;
+		 dest_ptr->list_sorted_state = src_ptr->list_sorted_state;
+	 }
+	 else {
+		 dest_ptr->tail->next = first;
+		 first->prev = dest_ptr->tail;
+		 dest_ptr->list_sorted_state = UNSORTED_LIST;
+	 }
+	 dest_ptr->tail = src_ptr->tail;
+	 dest_ptr->current_list_size += src_ptr->current_list_size;
+	 src_ptr->head = NULL;
+	 src_ptr->tail = NULL;
+	 src_ptr->current_list_size = 0;
+	 if (src_ptr->mode & LIST_SKIP) {
+		 src_ptr->skip_levels = 1; // an empty list is sorted
+	 }
+	 src_ptr->list_sorted_state = SORTED_LIST;
+
+	 if (dest_ptr->hash_table != NULL || dest_ptr->side_table != NULL) {
+		 for (N = first; N != NULL; N = N->next) {
+			 if (dest_ptr->hash_table != NULL) {
+				 HashAdd(dest_ptr, N);
+			 }
+			 if (dest_ptr->side_table != NULL) {
+				 SideAdd(dest_ptr, N);
+			 }
+			 if (dest_ptr->group_count > 0) {
+				 GroupAppend(dest_ptr, N);
+			 }
+		 }
+	 }
+	 dest_ptr->column_dirty = 1;
+	 if (dest_ptr->skip_levels > 0) {
+		 SkipClear(dest_ptr);
+	 }
+	 if ((dest_ptr->mode & LIST_SKIP) && dest_ptr->list_sorted_state == SORTED_LIST) {
+		 SkipRebuild(dest_ptr);
+	 }
+
+    // list_debug_validate(dest_ptr);
+}
+
+/* Cuts a list in two at an iterator.
+ *
+ * list_ptr: the list to cut.  It keeps the elements in front of idx_ptr.
+ * idx_ptr:  the first element to move.  Nothing happens if it is NULL.
+ * rest_ptr: an empty list that receives idx_ptr and every element after
+ *           it, in order.  It takes the sorted state of list_ptr.
+ *
+ * The chain is cut in O(1) when the lists share an allocator.  The moved
+ * elements are still walked once to count them, and to move them between
+ * the indexes of the two lists.
+ */
+void list_split(list_t *list_ptr, list_node_t *idx_ptr, list_t *rest_ptr)
+{
+	 list_node_t *N, *next;
+	 int count = 0;
+
+    assert(NULL != list_ptr && NULL != rest_ptr && list_ptr != rest_ptr);
+    assert(0 == rest_ptr->current_list_size);
+	 if (idx_ptr == NULL) {
+		 return;
+	 }
+	 if (!NodeShared(rest_ptr, list_ptr)) {
+		 for (N = idx_ptr; N != NULL; N = next) {
+			 next = N->next;
+			 list_transfer(rest_ptr, NULL, list_ptr, N);
+		 }
+		 rest_ptr->list_sorted_state = list_ptr->list_sorted_state;
+		 return;
+	 }
+
+	 for (N = idx_ptr; N != NULL; N = N->next) {
+		 if (list_ptr->hash_table != NULL) {
+			 HashRemove(list_ptr, N);
+		 }
+		 if (list_ptr->group_count > 0) {
+			 GroupRemove(list_ptr, N);
+		 }
+		 if (list_ptr->column != NULL) {
+			 ColumnRemove(list_ptr, N);
+		 }
+		 if (list_ptr->skip_levels > 0) {
+			 SkipUnlink(list_ptr, N);
+		 }
+		 if (list_ptr->side_table != NULL) {
+			 SideRemove(list_ptr, N);
+		 }
+		 if (rest_ptr->hash_table != NULL) {
+			 HashAdd(rest_ptr, N);
+		 }
+		 if (rest_ptr->side_table != NULL) {
+			 SideAdd(rest_ptr, N);
+		 }
+		 if (rest_ptr->group_count > 0) {
+			 GroupAppend(rest_ptr, N);
+		 }
+		 count++;
+	 }
+
+	 rest_ptr->head = idx_ptr;
+	 rest_ptr->tail = list_ptr->tail;
+	 rest_ptr->current_list_size = count;
+	 list_ptr->tail = idx_ptr->prev;
+	 if (list_ptr->tail == NULL) {
+		 list_ptr->head = NULL;
+	 }
+	 else {
+		 list_ptr->tail->next = NULL;
+	 }
+	 idx_ptr->prev = NULL;
+	 list_ptr->current_list_size -= count;
+
+	 rest_ptr->list_sorted_state = list_ptr->list_sorted_state;
+	 rest_ptr->column_dirty = 1;
+	 rest_ptr->skip_levels = 0;
+	 if ((rest_ptr->mode & LIST_SKIP) && rest_ptr->list_sorted_state == SORTED_LIST) {
+		 SkipRebuild(rest_ptr);
+	 }
+
+    // list_debug_validate(list_ptr);
+    // list_debug_validate(rest_ptr);
+}
+
+/* Inserts the data element into the list in front of the iterator 
+ * position.
+ *
+ * list_ptr: pointer to list-of-interest.  
+ *
+ * elem_ptr: pointer to the memory block to be inserted into list.
+ *
+ * idx_ptr: pointer to a list_node_t.  The element is to be inserted as a 
+ *          member in the list at the position that is immediately in front 
+ *          of the position of the provided Iterator pointer.
+ *
+ *          If the idx_ptr pointer is NULL, the the new memory block is
+ *          inserted after the last element in the list.  That is, a null
+ *          iterator pointer means make the element the new tail.
+ *
+ * If idx_ptr is set using 
+ *    -- list_iter_front, then the new element becomes the first item in 
+ *       the list.
+ *    -- list_iter_back, then the new element is inserted before the last item 
+ *       in the list.
+ *    -- for any other idx_ptr, the new element is insert before the 
+ *       Iterator
+ *
+ * For example, to insert at the tail of the list do
+ *      list_insert(mylist, myelem, NULL)
+ * to insert at the front of the list do
+ *      list_insert(mylist, myelem, list_iter_front(mylist))
+ *
+ * Note that use of this function results in the list to be marked as unsorted,
+ * even if the element has been inserted in the correct position.  That is, on
+ * completion of this subroutine the list_ptr->list_sorted_state must be equal 
+ * to UNSORTED_LIST.
+ */
+void list_insert(list_t *list_ptr, data_t *elem_ptr, list_node_t * idx_ptr)
+{
+    assert(NULL != list_ptr);
+
+	// make new node for the data
+	 NodeLink(list_ptr, NodeAlloc(list_ptr, elem_ptr), idx_ptr);
+}
+
+/* Sorts the given list using the specified algorithm.
+ * 
  * list_ptr: pointer to list of interest.
  * 
  * sort_type: integer that specifies which sort algorithm to use.
@@ -348,8 +1217,28 @@ void list_insert(list_t *list_ptr, data_t *elem_ptr, list_node_t * idx_ptr)
  *					2- recursive selection sort
  *					3- iterative selection sort
  *					4- merge sort
+ *					5- merge sort that relinks nodes, allocating nothing
+ *					6- bottom-up merge sort, no recursion
+ *					7- natural merge sort that reuses runs already in the list
+ *					8- radix sort on the key from key_proc (falls back to 7
+ *					   if the list has no key_proc)
+ *					9- merge sort split across threads, see list_set_sort_threads
+ *					10- merge sort of an array of the keys from key_proc, then
+ *					   one pass to relink the nodes (falls back to 7 if the
+ *					   list has no key_proc)
  */
 void list_sort(ListPtr list_ptr, int sort_type) {
+		// sorts 1 to 4 move elements to other nodes, so drop the index now
+		// and build it again after, instead of updating it on every move
+		int rebuild = (list_ptr->hash_table != NULL && sort_type >= 1 && sort_type <= 4);
+		if (rebuild) {
+			free(list_ptr->hash_table);
+			list_ptr->hash_table = NULL;
+		}
+		if (list_ptr->skip_levels > 0) {
+			SkipClear(list_ptr);
+		}
+
 		if (sort_type == 1) { // insertion sort
 			InsertionSort(list_ptr);
 		}
@@ -362,13 +1251,353 @@ void list_sort(ListPtr list_ptr, int sort_type) {
 		else if (sort_type == 4) { // merge sort
 			MergeSort(list_ptr);
 		}
+		else if (sort_type == 5) { // merge sort by relinking
+			MergeSortRelink(list_ptr);
+		}
+		else if (sort_type == 6) { // bottom-up merge sort
+			MergeSortBottomUp(list_ptr);
+		}
+		else if (sort_type == 7) { // natural merge sort
+			NaturalMergeSort(list_ptr);
+		}
+		else if (sort_type == 8) { // radix sort
+			if (list_ptr->key_proc != NULL) {
+				RadixSort(list_ptr);
+			}
+			else {
+				NaturalMergeSort(list_ptr);
+			}
+		}
+		else if (sort_type == 9) { // parallel merge sort
+			ParallelMergeSort(list_ptr);
+		}
+		else if (sort_type == 10) { // key array sort
+			if (list_ptr->key_proc != NULL) {
+				KeySort(list_ptr);
+			}
+			else {
+				NaturalMergeSort(list_ptr);
+			}
+		}
 		else { // invalid sort type
+			sort_type = 0;
+		}
+		PERF_COUNT(list_ptr, sorts[sort_type]);
+
+		if (rebuild) {
+			HashRebuild(list_ptr);
+		}
+		if (sort_type == 0) {
+			if (list_ptr->list_sorted_state == SORTED_LIST && (list_ptr->mode & LIST_SKIP)) {
+				SkipRebuild(list_ptr);
+			}
 			return;
 		}
+		if (list_ptr->group_count > 0) {
+			GroupRebuild(list_ptr);
+		}
+		list_ptr->column_dirty = 1;
 		list_ptr->list_sorted_state = SORTED_LIST;
+		if (list_ptr->mode & LIST_SKIP) {
+			SkipRebuild(list_ptr);
+		}
 		list_debug_validate(list_ptr);
 }
 
+/* Sets how many threads list_sort may use for the parallel merge sort.
+ *
+ * sort_threads: the thread count, or 0 (the default) for one thread per
+ *               online processor.  Fewer threads are used when the list is
+ *               too short to give each one a worthwhile share.
+ */
+void list_set_sort_threads(list_t *list_ptr, int sort_threads)
+{
+    assert(NULL != list_ptr);
+	 assert(sort_threads >= 0);
+	 list_ptr->sort_threads = sort_threads;
+}
+
+/* Adds a secondary index to an empty list that chains together the
+ * elements of each group, in list order.  Walking one group then costs
+ * O(size of the group) instead of a scan of the whole list.
+ *
+ * fgroup: maps an element to its group, 0 to group_count - 1.  The group
+ *         of an element in the list may only change through
+ *         list_group_retag.
+ *
+ * Inserting finds the nearest element of the same group by walking out 
+ * from the new node in both directions, which is short when the groups
+ * are well mixed.  Removing is O(1).  The chain links are kept in a side
+ * table of the list found by node address, not in the nodes, so lists
+ * without groups do not pay for them.
+ */
+void list_set_groups(list_t *list_ptr, int (*fgroup)(const data_t *), int group_count)
+{
+    assert(NULL != list_ptr);
+	 assert(list_ptr->current_list_size == 0 && list_ptr->group_count == 0);
+	 assert(group_count > 0);
+
+	 list_ptr->group_proc = fgroup;
+	 list_ptr->group_count = group_count;
+	 list_ptr->group_head = (list_node_t **) calloc(group_count, sizeof(list_node_t *));
+	 list_ptr->group_tail = (list_node_t **) calloc(group_count, sizeof(list_node_t *));
+	 list_ptr->group_size = (int *) calloc(group_count, sizeof(int));
+	 if (list_ptr->side_table == NULL) {
+		 SideReset(list_ptr, LIST_SIDE_MIN_BITS);
+	 }
+}
+
+/* Returns the number of groups of the list, or 0 if it has no group index.
+ */
+int list_group_count(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+	 return list_ptr->group_count;
+}
+
+/* Returns the number of elements in the group.
+ */
+int list_group_size(list_t *list_ptr, int group)
+{
+    assert(NULL != list_ptr);
+	 assert(group >= 0 && group < list_ptr->group_count);
+	 return list_ptr->group_size[group];
+}
+
+/* Return an Iterator to the first element of the group, in list order, or
+ * NULL if the group is empty.
+ */
+list_node_t * list_group_front(list_t *list_ptr, int group)
+{
+    assert(NULL != list_ptr);
+	 assert(group >= 0 && group < list_ptr->group_count);
+	 return list_ptr->group_head[group];
+}
+
+/* Advance the Iterator to the next element of the same group, or return
+ * NULL after the last one.  The same cautions as list_iter_next apply.
+ */
+list_node_t * list_group_next(list_t *list_ptr, list_node_t * idx_ptr)
+{
+    assert(NULL != list_ptr && idx_ptr != NULL);
+	 return SideFind(list_ptr, idx_ptr)->group_next;
+}
+
+/* Moves every element of old_group into new_group.  The caller has already
+ * changed the elements so that fgroup now returns new_group for them.
+ *
+ * In a sorted list the two chains are merged in order, which costs 
+ * O(size of both groups) and touches no other node.  An unsorted list
+ * has no cheap way to order the two chains, so they are rebuilt with a 
+ * pass over the list.
+ */
+void list_group_retag(list_t *list_ptr, int old_group, int new_group)
+{
+    assert(NULL != list_ptr);
+	 assert(old_group >= 0 && old_group < list_ptr->group_count);
+	 assert(new_group >= 0 && new_group < list_ptr->group_count);
+
+	 list_node_t *a, *b, *last = NULL, *N;
+	 list_side_t *S;
+
+	 if (old_group == new_group || list_ptr->group_size[old_group] == 0) {
+		 return;
+	 }
+	 for (N = list_ptr->group_head[old_group]; N != NULL; N = S->group_next) {
+		 assert(list_ptr->group_proc(N->data_ptr) == new_group);
+		 S = SideFind(list_ptr, N);
+		 S->group = new_group;
+	 }
+	 if (list_ptr->list_sorted_state != SORTED_LIST) {
+		 GroupRebuild(list_ptr);
+		 return;
+	 }
+
+	 a = list_ptr->group_head[new_group];
+	 b = list_ptr->group_head[old_group];
+	 list_ptr->group_head[new_group] = NULL;
+	 while (a != NULL || b != NULL) {
+		 if (b == NULL || (a != NULL && GroupBefore(list_ptr, a, b))) {
+			 N = a;
+			 a = SideFind(list_ptr, a)->group_next;
+		 }
+		 else {
+			 N = b;
+			 b = SideFind(list_ptr, b)->group_next;
+		 }
+		 SideFind(list_ptr, N)->group_prev = last;
+		 if (last == NULL) {
+			 list_ptr->group_head[new_group] = N;
+		 }
+		 else {
+			 SideFind(list_ptr, last)->group_next = N;
+		 }
+		 last = N;
+	 }
+	 SideFind(list_ptr, last)->group_next = NULL;
+	 list_ptr->group_tail[new_group] = last;
+	 list_ptr->group_size[new_group] += list_ptr->group_size[old_group];
+	 list_ptr->group_head[old_group] = NULL;
+	 list_ptr->group_tail[old_group] = NULL;
+	 list_ptr->group_size[old_group] = 0;
+}
+
+/* Keeps the group of every element of an empty list in a column: one byte
+ * per element, in list order, next to an array of the nodes.  Finding the
+ * elements of a group then scans the bytes with SSE2 or AVX2 compares,
+ * 16 or 32 elements at a time, instead of following the links and loading
+ * each element.
+ *
+ * fgroup: maps an element to its group, 0 to group_count - 1, and
+ *         group_count may be at most LIST_COLUMN_GROUPS.  The group of an
+ *         element in the list may only change through list_column_retag.
+ *
+ * Appending at the tail adds to the column and removing marks the slot of
+ * the element as empty, in O(1).  Any other insert, or a sort, leaves the
+ * column to be built again with one pass over the list at the next
+ * list_column_match or list_column_retag.  The slot of each node is kept
+ * in the same side table as the group chains.
+ */
+void list_set_column(list_t *list_ptr, int (*fgroup)(const data_t *), int group_count)
+{
+    assert(NULL != list_ptr);
+	 assert(list_ptr->current_list_size == 0 && list_ptr->column == NULL);
+	 assert(group_count > 0 && group_count <= LIST_COLUMN_GROUPS);
+
+	 list_ptr->column_proc = fgroup;
+	 list_ptr->column_groups = group_count;
+	 list_ptr->column_cap = LIST_COLUMN_MIN;
+	 list_ptr->column = (unsigned char *) malloc(LIST_COLUMN_MIN);
+	 list_ptr->column_node = (list_node_t **) malloc(LIST_COLUMN_MIN * sizeof(list_node_t *));
+	 list_ptr->column_len = 0;
+	 list_ptr->column_dirty = 0;
+	 if (list_ptr->side_table == NULL) {
+		 SideReset(list_ptr, LIST_SIDE_MIN_BITS);
+	 }
+}
+
+/* Returns the number of groups of the group column, or 0 if the list has
+ * none.
+ */
+int list_column_groups(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+	 return list_ptr->column_groups;
+}
+
+/* Finds every element of a group with a scan of the group column.
+ *
+ * count: set to the number of elements found.
+ *
+ * Return: an array of the elements of the group, in list order.  The list
+ * owns the array and fills it again at the next list_column_match, so a
+ * query allocates nothing once the array is as long as the column.  The
+ * iterators are valid until the list is next changed, except that removing
+ * an element only makes its own iterator invalid.
+ *
+ * Building the column again changes the list, so a LIST_LOCKED list must
+ * be locked with LIST_WRITE.
+ */
+list_node_t **list_column_match(list_t *list_ptr, int group, int *count)
+{
+    assert(NULL != list_ptr && NULL != list_ptr->column && NULL != count);
+	 assert(group >= 0 && group < list_ptr->column_groups);
+
+	 const unsigned char *column;
+	 list_node_t **node, **match_array;
+	 int found = 0, len, i = 0;
+
+	 if (list_ptr->column_dirty) {
+		 ColumnRebuild(list_ptr);
+	 }
+	 if (list_ptr->column_match == NULL
+			 || list_ptr->column_match_cap < list_ptr->column_len) {
+		 list_ptr->column_match_cap = list_ptr->column_cap;
+		 free(list_ptr->column_match);
+		 list_ptr->column_match = (list_node_t **) malloc(
+				 list_ptr->column_match_cap * sizeof(list_node_t *));
+	 }
+	 match_array = list_ptr->column_match;
+	 column = list_ptr->column;
+	 node = list_ptr->column_node;
+	 len = list_ptr->column_len;
+#if defined(__AVX2__)
+	 __m256i key = _mm256_set1_epi8((char) group);
+	 unsigned int mask;
+	 for (; i + 32 <= len; i += 32) {
+		 mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(key,
+					 _mm256_loadu_si256((const __m256i *) (column + i))));
+		 while (mask != 0) {
+			 match_array[found++] = node[i + __builtin_ctz(mask)];
+			 mask &= mask - 1;
+		 }
+	 }
+#elif defined(__SSE2__)
+	 __m128i key = _mm_set1_epi8((char) group);
+	 unsigned int mask;
+	 for (; i + 16 <= len; i += 16) {
+		 mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(key,
+					 _mm_loadu_si128((const __m128i *) (column + i))));
+		 while (mask != 0) {
+			 match_array[found++] = node[i + __builtin_ctz(mask)];
+			 mask &= mask - 1;
+		 }
+	 }
+#endif
+	 for (; i < len; i++) {
+		 if (column[i] == group) {
+			 match_array[found++] = node[i];
+		 }
+	 }
+	 *count = found;
+	 return match_array;
+}
+
+/* Moves every element of old_group into new_group in the group column.
+ * The caller has already changed the elements so that fgroup now returns
+ * new_group for them.  The column is rewritten with vector blends, without
+ * touching any element.
+ */
+void list_column_retag(list_t *list_ptr, int old_group, int new_group)
+{
+    assert(NULL != list_ptr && NULL != list_ptr->column);
+	 assert(old_group >= 0 && old_group < list_ptr->column_groups);
+	 assert(new_group >= 0 && new_group < list_ptr->column_groups);
+
+	 unsigned char *column;
+	 int len, i = 0;
+
+	 if (list_ptr->column_dirty) {
+		 ColumnRebuild(list_ptr); // reads the new groups from the elements
+		 return;
+	 }
+	 column = list_ptr->column;
+	 len = list_ptr->column_len;
+#if defined(__AVX2__)
+	 __m256i from = _mm256_set1_epi8((char) old_group);
+	 __m256i to = _mm256_set1_epi8((char) new_group);
+	 for (; i + 32 <= len; i += 32) {
+		 __m256i v = _mm256_loadu_si256((const __m256i *) (column + i));
+		 v = _mm256_blendv_epi8(v, to, _mm256_cmpeq_epi8(v, from));
+		 _mm256_storeu_si256((__m256i *) (column + i), v);
+	 }
+#elif defined(__SSE2__)
+	 __m128i from = _mm_set1_epi8((char) old_group);
+	 __m128i to = _mm_set1_epi8((char) new_group);
+	 for (; i + 16 <= len; i += 16) {
+		 __m128i v = _mm_loadu_si128((const __m128i *) (column + i));
+		 __m128i hit = _mm_cmpeq_epi8(v, from);
+		 v = _mm_or_si128(_mm_and_si128(hit, to), _mm_andnot_si128(hit, v));
+		 _mm_storeu_si128((__m128i *) (column + i), v);
+	 }
+#endif
+	 for (; i < len; i++) {
+		 if (column[i] == old_group) {
+			 column[i] = (unsigned char) new_group;
+		 }
+	 }
+}
+
 /* Removes the element from the specified list that is found at the 
  * iterator pointer.  A pointer to the data element is returned.
  *
@@ -409,51 +1638,16 @@ data_t * list_remove(list_t *list_ptr, list_node_t * idx_ptr)
 
 	 
 	 data_t *removedData = NULL; // to save ptr to the data for return
-	 // if only 1 entry, handle differently
-	 if (1 == list_ptr->current_list_size) {
-		 removedData = list_ptr->head->data_ptr;
-		 free (list_ptr->head);
-		 list_ptr->head = NULL;
-		 list_ptr->tail = NULL;
+	 if (idx_ptr == NULL) {
+		 idx_ptr = list_ptr->head;
 	 }
-	 else if ((idx_ptr == NULL) || (idx_ptr == list_ptr->head)) { // 
-		 IteratorPtr oldFront = list_ptr->head;
-		 removedData = oldFront->data_ptr;
-		 list_ptr->head = oldFront->next; // if front removed, select new head
-		 list_ptr->head->prev = NULL;
+	 NodeUnlink(list_ptr, idx_ptr);
+	 removedData = idx_ptr->data_ptr;
 
-		 oldFront->data_ptr = NULL;
-		 oldFront->next = NULL;
-		 oldFront->prev = NULL;
-		 free(oldFront);
-		 oldFront = NULL;
-	 }
-	 else if (idx_ptr == list_ptr->tail) {
-		 IteratorPtr oldBack = list_ptr->tail;
-		 removedData = oldBack->data_ptr;
-		 list_ptr->tail = oldBack->prev; // if back removed, select new tail
-		 list_ptr->tail->next = NULL;
-
-		 oldBack->data_ptr = NULL;
-		 oldBack->next = NULL;
-		 oldBack->prev = NULL;
-		 free(oldBack);
-		 oldBack = NULL;
-	 }
-	 else { // removing entry in middle
-		 removedData = idx_ptr->data_ptr;
-
-		 // skip over removed entry
-		 idx_ptr->prev->next = idx_ptr->next;
-		 idx_ptr->next->prev = idx_ptr->prev;
-
-		 idx_ptr->prev = NULL;
-		 idx_ptr->next = NULL;
-		 idx_ptr->data_ptr = NULL;
-		 free(idx_ptr);
-		 idx_ptr = NULL;
-	 }
-	 list_ptr->current_list_size--;
+	 // null the links before the block is returned
+	 idx_ptr->data_ptr = NULL;
+	 NodeFree(list_ptr, idx_ptr);
+	 idx_ptr = NULL;
 
     // the last line should verify the list is valid after the remove 
     // list_debug_validate(list_ptr);
@@ -490,6 +1684,76 @@ data_t * list_access(list_t *list_ptr, list_node_t * idx_ptr)
     return idx_ptr->data_ptr;
 }
 
+/* Allocate a zeroed record from the allocator used by the list.
+ *
+ * Records stored in a list constructed with LIST_POOL or LIST_INTRUSIVE 
+ * must come from this function (or from a list sharing the same allocator),
+ * since list_destruct returns them to it.  For LIST_MALLOC lists this is
+ * calloc.  For LIST_INTRUSIVE lists the record comes with its node.
+ */
+data_t * list_elem_alloc(list_t *list_ptr)
+{
+    assert(NULL != list_ptr);
+	 data_t *elem_ptr;
+
+	 if (list_ptr->mode & LIST_INTRUSIVE) {
+		 list_rec_t *rec;
+		 if (list_ptr->pool != NULL) {
+			 PERF_COUNT(list_ptr, pool_allocs);
+			 rec = (list_rec_t *) PoolAlloc(list_ptr->pool, LIST_POOL_ELEM);
+		 }
+		 else {
+			 PERF_COUNT(list_ptr, mallocs);
+			 rec = (list_rec_t *) malloc(sizeof(list_rec_t));
+		 }
+		 memset(&rec->data, 0, sizeof(data_t));
+		 rec->node.data_ptr = &rec->data;
+		 rec->node.prev = NULL;
+		 rec->node.next = NULL;
+		 elem_ptr = &rec->data;
+	 }
+	 else if (list_ptr->pool != NULL) {
+		 PERF_COUNT(list_ptr, pool_allocs);
+		 elem_ptr = (data_t *) PoolAlloc(list_ptr->pool, LIST_POOL_ELEM);
+		 memset(elem_ptr, 0, sizeof(data_t));
+	 }
+	 else {
+		 PERF_COUNT(list_ptr, mallocs);
+		 elem_ptr = (data_t *) calloc(1, sizeof(data_t));
+	 }
+	 return elem_ptr;
+}
+
+/* Return a record obtained from list_elem_alloc.  The record must not be
+ * in any list.  A NULL elem_ptr is ignored, like free.
+ */
+void list_elem_free(list_t *list_ptr, data_t *elem_ptr)
+{
+    assert(NULL != list_ptr);
+	 if (elem_ptr == NULL) {
+		 return;
+	 }
+	 if (list_ptr->mode & LIST_INTRUSIVE) {
+		 list_rec_t *rec = REC_OF(elem_ptr);
+		 if (list_ptr->pool != NULL) {
+			 PERF_COUNT(list_ptr, pool_frees);
+			 PoolFree(list_ptr->pool, LIST_POOL_ELEM, rec);
+		 }
+		 else {
+			 PERF_COUNT(list_ptr, frees);
+			 free(rec);
+		 }
+	 }
+	 else if (list_ptr->pool != NULL) {
+		 PERF_COUNT(list_ptr, pool_frees);
+		 PoolFree(list_ptr->pool, LIST_POOL_ELEM, elem_ptr);
+	 }
+	 else {
+		 PERF_COUNT(list_ptr, frees);
+		 free(elem_ptr);
+	 }
+}
+
 /*** Private Functions ***/
 
 /* This function verifies that the pointers for the two-way linked list are
@@ -533,11 +1797,59 @@ void list_debug_validate(list_t *L)
             if (NULL != R->next) assert(R->next->prev == R);
             else assert(R == L->tail);
             assert(NULL != R->data_ptr);
+            if (L->mode & LIST_INTRUSIVE) assert(R == &REC_OF(R->data_ptr)->node);
             ++tally;
             R = R->next;
         }
         assert(tally == L->current_list_size);
     }
+    if (0 < L->group_count) {
+        int g, grouped = 0;
+        for (g = 0; g < L->group_count; g++) {
+            list_node_t *R = L->group_head[g];
+            int tally = 0;
+            while (NULL != R) {
+                list_side_t *S = SideFind(L, R);
+                assert(S->node == R && S->group == g);
+                if (NULL != S->group_next) assert(SideFind(L, S->group_next)->group_prev == R);
+                else assert(R == L->group_tail[g]);
+                ++tally;
+                R = S->group_next;
+            }
+            assert(tally == L->group_size[g]);
+            grouped += tally;
+        }
+        assert(grouped == L->current_list_size);
+    }
+    if (0 < L->skip_levels) {
+        int lvl;
+        assert(SORTED_LIST == L->list_sorted_state);
+        for (lvl = 1; lvl < L->skip_levels; lvl++) {
+            list_skip_t *T = L->skip_head[lvl];
+            list_node_t *B = L->head;  // walks the base list alongside
+            while (NULL != T) {
+                assert(T->level > lvl);
+                while (B != T->node) {
+                    assert(NULL != B);
+                    B = B->next;
+                }
+                B = B->next;
+                T = T->next[lvl - 1];
+            }
+        }
+    }
+    if (NULL != L->side_table) {
+        list_node_t *R;
+        for (R = L->head; NULL != R; R = R->next)
+            assert(SideFind(L, R)->node == R);
+        assert(L->side_used == L->current_list_size);
+    }
+    if (NULL != L->hash_table) {
+        int slot, indexed = 0;
+        for (slot = 0; slot < (1 << L->hash_bits); slot++)
+            indexed += L->hash_table[slot].count;
+        assert(indexed == L->current_list_size);
+    }
     if (NULL != L->head && SORTED_LIST == L->list_sorted_state) {
         list_node_t *R = L->head;
         while (NULL != R->next) {
@@ -547,12 +1859,41 @@ void list_debug_validate(list_t *L)
     }
 }
 
+/* Allocates an empty list with the same methods as L that shares its 
+ * allocator, so nodes can be moved between the two.  Used for the temporary
+ * lists of the sorts, which need no index.
+ */
+list_t* ListConstructLike(list_t *L) {
+	return list_construct_mode(L->comp_proc, L->key_proc,
+			L->mode & LIST_ALLOC_FLAGS, L);
+}
+
+/* Adds the operation counts of part, a temporary list of a sort, to L
+ * before part is destructed, counting the malloc and free of its header.
+ */
+void PerfMerge(list_t *L, list_t *part) {
+#ifdef LIST_PERF
+	int i;
+
+	L->perf.comparisons += part->perf.comparisons;
+	L->perf.find_visits += part->perf.find_visits;
+	L->perf.insert_visits += part->perf.insert_visits;
+	L->perf.mallocs += part->perf.mallocs + 1;
+	L->perf.frees += part->perf.frees + 1;
+	L->perf.pool_allocs += part->perf.pool_allocs;
+	L->perf.pool_frees += part->perf.pool_frees;
+	for (i = 0; i <= LIST_SORT_TYPES; i++) {
+		L->perf.sorts[i] += part->perf.sorts[i];
+	}
+#endif
+}
+
 /* Implements an insertion sort to sort a given list.
  * 
  * list_ptr: the list to be sorted
  */
 void InsertionSort(ListPtr list_ptr) {
-	ListPtr newList = list_construct(list_ptr->comp_proc);
+	ListPtr newList = ListConstructLike(list_ptr);
 	while (list_ptr->head != NULL) { // continue until list empty
 		// put head from given list into new list
 		list_insert_sorted(newList, list_remove(list_ptr, list_ptr->head));
@@ -561,7 +1902,12 @@ void InsertionSort(ListPtr list_ptr) {
 	list_ptr->head = newList->head;
 	list_ptr->tail = newList->tail;
 	list_ptr->current_list_size = newList->current_list_size;
-	free(newList);
+	// nodes now belong to list_ptr, so only the header is destructed
+	newList->head = NULL;
+	newList->tail = NULL;
+	newList->current_list_size = 0;
+	PerfMerge(list_ptr, newList);
+	list_destruct(newList);
 	newList = NULL;
 }
 
@@ -576,13 +1922,10 @@ void InsertionSort(ListPtr list_ptr) {
  */
 void SelectionSortR(list_t *A, list_node_t *m, list_node_t *n) {
 	list_node_t *maxPosition;
-	data_t *temp;
 
 	if (m != n) { // if there's more than one node to sort
 		maxPosition = FindMax(A, m, n);
-		temp = m->data_ptr;
-		m->data_ptr = maxPosition->data_ptr;
-		maxPosition->data_ptr = temp;
+		SwapData(A, m, maxPosition);
 		SelectionSortR(A, m->next, n);
 	}
 }
@@ -599,7 +1942,7 @@ list_node_t* FindMax(list_t *A, list_node_t *m, list_node_t *n) {
 
 	do {
 		i = i->next;
-		if (A->comp_proc(i->data_ptr, j->data_ptr) == 1) {
+		if (COMPARE(A, i->data_ptr, j->data_ptr) == 1) {
 			j = i;
 		}
 	} while (i != n);
@@ -618,40 +1961,61 @@ list_node_t* FindMax(list_t *A, list_node_t *m, list_node_t *n) {
  */
 void SelectionSortI(list_t *A, list_node_t *m, list_node_t *n) {
 	list_node_t *maxPosition, *i;
-	data_t *temp;
 
 	while (m != n) { // while more than one node to sort
 		i = m;
 		maxPosition = m;
 		do {
 			i = i->next;
-			if (A->comp_proc(i->data_ptr, maxPosition->data_ptr) == 1) {
+			if (COMPARE(A, i->data_ptr, maxPosition->data_ptr) == 1) {
 				maxPosition = i;
 			}
 		} while (i != n);
-		temp = m->data_ptr;
-		m->data_ptr = maxPosition->data_ptr;
-		maxPosition->data_ptr = temp;
+		SwapData(A, m, maxPosition);
 		m = m->next;
 	}
 }
 
+/* Exchanges the elements held by two nodes of the list.  A support function
+ * for the selection sorts.
+ *
+ * An intrusive record cannot leave its node, so the contents are swapped
+ * instead of the pointers.
+ */
+void SwapData(list_t *A, list_node_t *x, list_node_t *y) {
+	if (x == y) {
+		return;
+	}
+	if (A->mode & LIST_INTRUSIVE) {
+		data_t temp = *x->data_ptr;
+		*x->data_ptr = *y->data_ptr;
+		*y->data_ptr = temp;
+	}
+	else {
+		data_t *temp = x->data_ptr;
+		x->data_ptr = y->data_ptr;
+		y->data_ptr = temp;
+	}
+}
+
 /* Sorts a given using using the merge sort algorithm
  *
  * list: the list to be sorted
  */
 void MergeSort(list_t *list) {
-	if (list->head->next != NULL) { // >1 item in list
-		list_t* rList = list_construct(list->comp_proc);
-		list_t* lList = list_construct(list->comp_proc);
+	if (list->head != NULL && list->head->next != NULL) { // >1 item in list
+		list_t* rList = ListConstructLike(list);
+		list_t* lList = ListConstructLike(list);
 
 		HalveList(list, rList, lList);
 		MergeSort(lList);
 		MergeSort(rList);
 		CombineLists(list, rList, lList);
 
-		free(rList);
-		free(lList);
+		PerfMerge(list, rList);
+		PerfMerge(list, lList);
+		list_destruct(rList);
+		list_destruct(lList);
 		rList = NULL;
 		lList = NULL;
 	}
@@ -666,14 +2030,15 @@ void MergeSort(list_t *list) {
  */
 void HalveList(list_t* list_ptr, list_t* rList, list_t* lList) {
 	int halfSize = list_ptr->current_list_size / 2;
+	list_node_t *N = list_ptr->tail;
 	int i = 0;
 
-	for (i = 0; i < halfSize; i++) {
-		list_insert(rList, list_remove(list_ptr, list_ptr->tail), rList->head);
-	}
-	while (list_ptr->head != NULL) {
-		list_insert(lList, list_remove(list_ptr, list_ptr->tail), lList->head);
+	// the last halfSize nodes go right, the rest go left
+	for (i = 1; i < halfSize; i++) {
+		N = N->prev;
 	}
+	list_split(list_ptr, N, rList);
+	list_splice(lList, list_ptr);
 }
 
 /* Takes two given lists and combines them into one. A support function
@@ -688,26 +2053,1597 @@ void CombineLists (list_t* list_ptr, list_t* rList, list_t* lList) {
 	while (1) {
 		// both lists non empty
 		if ((lList->head != NULL) && (rList->head != NULL)) {
-			if (lList->comp_proc(lList->head->data_ptr, rList->head->data_ptr) == 1) {
-				list_insert(list_ptr, list_remove(lList, lList->head), NULL);
+			if (COMPARE(lList, lList->head->data_ptr, rList->head->data_ptr) == 1) {
+				list_transfer(list_ptr, NULL, lList, NULL);
 			}
 			else {
-				list_insert(list_ptr, list_remove(rList, rList->head), NULL);
+				list_transfer(list_ptr, NULL, rList, NULL);
 			}
 		}
 		// both lists empty
 		else if ((lList->head == NULL) && (rList->head == NULL)) {
 			return; // merging complete, exit loop and return
 		}
-		// one list empty
+		// one list empty, the other one is already in order
 		else {
 			if (lList->head == NULL) {
-				list_insert(list_ptr, list_remove(rList, rList->head), NULL);
+				list_splice(list_ptr, rList);
+			}
+			else {
+				list_splice(list_ptr, lList);
+			}
+			return;
+		}
+	}
+}
+
+
+/* Sorts the list with a merge sort that only rewires the links between the
+ * existing nodes.  Nothing is allocated and no element is copied.
+ *
+ * The nodes are sorted as a chain linked through next only, and the prev
+ * links, head and tail are repaired in a single pass at the end.  The sort 
+ * is stable.
+ */
+void MergeSortRelink(list_t *L) {
+	if (L->current_list_size < 2) {
+		return;
+	}
+	RelinkPrev(L, SortChain(L, L->head));
+}
+
+/* Sorts a NULL terminated chain of nodes linked through next and returns
+ * its new first node.  The prev links are left stale.  A support function
+ * for the relinking merge sort.
+ *
+ * The chain is split in the middle with a slow pointer that advances one
+ * node while a fast pointer advances two.
+ */
+list_node_t* SortChain(list_t *L, list_node_t *head) {
+	list_node_t *slow, *fast, *right;
+
+	if (head == NULL || head->next == NULL) {
+		return head;
+	}
+	slow = head;
+	fast = head->next;
+	while (fast != NULL && fast->next != NULL) {
+		slow = slow->next;
+		fast = fast->next->next;
+	}
+	right = slow->next;
+	slow->next = NULL;
+
+	return MergeChains(L, SortChain(L, head), SortChain(L, right));
+}
+
+/* Merges two sorted chains linked through next into one and returns its
+ * first node.  On a tie the node from a goes first, which keeps the sort
+ * stable.
+ */
+list_node_t* MergeChains(list_t *L, list_node_t *a, list_node_t *b) {
+	list_node_t front; // only front.next is used
+	list_node_t *last = &front;
+
+	while (a != NULL && b != NULL) {
+		if (COMPARE(L, b->data_ptr, a->data_ptr) == 1) {
+			last->next = b;
+			b = b->next;
+		}
+		else {
+			last->next = a;
+			a = a->next;
+		}
+		last = last->next;
+	}
+	last->next = (a != NULL) ? a : b;
+	return front.next;
+}
+
+/* Sorts the list with a merge sort that uses no recursion, so the stack use
+ * is the same for any list size.
+ *
+ * The chain is cut into runs of LIST_SORT_RUN nodes, each sorted with an
+ * insertion sort that relinks nodes.  Runs are then merged in doubling
+ * widths like a binary counter: bin[i] holds a pending run of 2^i short
+ * runs, and a new run carries upward through the full bins.  Merging as
+ * soon as two runs of one width exist keeps the nodes being merged in 
+ * cache, unlike full passes over the list.  Nothing is allocated, prev
+ * links are fixed once at the end, and the sort is stable.
+ */
+void MergeSortBottomUp(list_t *L) {
+	if (L->current_list_size < 2) {
+		return;
+	}
+	RelinkPrev(L, SortChainBottomUp(L, L->head));
+}
+
+/* Sorts a NULL terminated chain linked through next with the bottom-up
+ * merge sort and returns its new first node.  The prev links are left 
+ * stale.  Only reads L, so several chains of one list can be sorted at once.
+ */
+list_node_t* SortChainBottomUp(list_t *L, list_node_t *head) {
+	list_node_t *bin[LIST_SORT_BINS];
+	list_node_t *rest, *run;
+	int i, top = 0;
+
+	rest = head;
+	while (rest != NULL) {
+		run = rest;
+		rest = CutChain(run, LIST_SORT_RUN);
+		run = InsertionSortChain(L, run);
+
+		// older runs hold earlier nodes, so they go first in a merge
+		for (i = 0; i < top && bin[i] != NULL; i++) {
+			run = MergeChains(L, bin[i], run);
+			bin[i] = NULL;
+		}
+		if (i == top) {
+			assert(top < LIST_SORT_BINS);
+			top++;
+		}
+		bin[i] = run;
+	}
+
+	// fold the pending runs together, smallest and newest first
+	run = NULL;
+	for (i = 0; i < top; i++) {
+		if (bin[i] != NULL) {
+			run = MergeChains(L, bin[i], run);
+		}
+	}
+	return run;
+}
+
+/* Ends the chain after its first count nodes and returns the node that
+ * followed them, or NULL if the chain was not longer than count.
+ */
+list_node_t* CutChain(list_node_t *head, int count) {
+	list_node_t *rest;
+
+	while (head != NULL && count > 1) {
+		head = head->next;
+		count--;
+	}
+	if (head == NULL) {
+		return NULL;
+	}
+	rest = head->next;
+	head->next = NULL;
+	return rest;
+}
+
+/* Sorts a short chain linked through next by moving each node behind the
+ * last node that does not rank after it.  Returns the new first node.
+ */
+list_node_t* InsertionSortChain(list_t *L, list_node_t *head) {
+	list_node_t front; // only front.next is used
+	list_node_t *N, *spot;
+
+	front.next = NULL;
+	while (head != NULL) {
+		N = head;
+		head = head->next;
+		spot = &front;
+		while (spot->next != NULL
+				&& COMPARE(L, N->data_ptr, spot->next->data_ptr) != 1) {
+			spot = spot->next;
+		}
+		N->next = spot->next;
+		spot->next = N;
+	}
+	return front.next;
+}
+
+/* Sorts the list with a merge sort that runs on several threads.
+ *
+ * The list is cut into one segment per thread by walking the next links.
+ * Each thread sorts its segment with the bottom-up merge sort, and the 
+ * sorted segments are then merged pairwise, each level of the merge tree 
+ * again running its merges on separate threads.  The calling thread does a
+ * share of the work at every step.  Segments are cut and merged in list
+ * order with ties going to the earlier segment, so the sort is stable.
+ * Lists too short to split are sorted on the calling thread.
+ */
+void ParallelMergeSort(list_t *L) {
+	sort_task_t task[LIST_PAR_MAX_THREADS];
+	pthread_t thread[LIST_PAR_MAX_THREADS];
+	int started[LIST_PAR_MAX_THREADS];
+	list_node_t *rest;
+	int threads = L->sort_threads;
+	int segments, i, length;
+
+	if (L->current_list_size < 2) {
+		return;
+	}
+	if (threads == 0) {
+		threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if (threads > L->current_list_size / LIST_PAR_MIN_NODES) {
+		threads = L->current_list_size / LIST_PAR_MIN_NODES;
+	}
+	if (threads > LIST_PAR_MAX_THREADS) {
+		threads = LIST_PAR_MAX_THREADS;
+	}
+	if (threads < 2) {
+		MergeSortBottomUp(L);
+		return;
+	}
+
+	// cut the chain into equal segments and sort each one
+	rest = L->head;
+	for (i = 0; i < threads; i++) {
+		length = L->current_list_size / threads;
+		if (i < L->current_list_size % threads) {
+			length++;
+		}
+		task[i].list = L;
+		task[i].first = rest;
+		task[i].second = NULL;
+		rest = CutChain(rest, length);
+	}
+	for (i = 1; i < threads; i++) {
+		started[i] = (pthread_create(&thread[i], NULL, SortSegmentWorker, &task[i]) == 0);
+		if (!started[i]) {
+			SortSegmentWorker(&task[i]);
+		}
+	}
+	SortSegmentWorker(&task[0]);
+	for (i = 1; i < threads; i++) {
+		if (started[i]) {
+			pthread_join(thread[i], NULL);
+		}
+	}
+
+	// merge neighbouring segments, halving their number each level
+	for (segments = threads; segments > 1; segments = (segments + 1) / 2) {
+		for (i = 0; i < segments / 2; i++) {
+			task[i].first = task[2*i].result;
+			task[i].second = task[2*i + 1].result;
+		}
+		if (segments % 2 == 1) {
+			// the odd segment out moves up a level unchanged
+			task[segments / 2].first = task[segments - 1].result;
+			task[segments / 2].result = task[segments - 1].result;
+		}
+		for (i = 1; i < segments / 2; i++) {
+			started[i] = (pthread_create(&thread[i], NULL, MergeSegmentsWorker, &task[i]) == 0);
+			if (!started[i]) {
+				MergeSegmentsWorker(&task[i]);
+			}
+		}
+		MergeSegmentsWorker(&task[0]);
+		for (i = 1; i < segments / 2; i++) {
+			if (started[i]) {
+				pthread_join(thread[i], NULL);
+			}
+		}
+	}
+	RelinkPrev(L, task[0].result);
+}
+
+/* Thread body of the parallel merge sort: sorts the chain task->first.
+ */
+void* SortSegmentWorker(void *task_ptr) {
+	sort_task_t *task = (sort_task_t *) task_ptr;
+	task->result = SortChainBottomUp(task->list, task->first);
+	return NULL;
+}
+
+/* Thread body of the parallel merge sort: merges task->first followed by
+ * task->second.
+ */
+void* MergeSegmentsWorker(void *task_ptr) {
+	sort_task_t *task = (sort_task_t *) task_ptr;
+	task->result = MergeChains(task->list, task->first, task->second);
+	return NULL;
+}
+
+/* Sorts the list with a natural merge sort in the style of TimSort, so the
+ * work done depends on how much order the list already has.
+ *
+ * The list is consumed as a series of runs: ascending runs are taken as
+ * they are, and strictly descending runs are reversed in place (strictly,
+ * so equal elements keep their order).  Runs shorter than LIST_MIN_RUN are
+ * extended by insertion.  Each run is pushed on a stack, and runs are 
+ * merged while the top three lengths break the TimSort invariants
+ *     len[n-2] > len[n-1] + len[n]   and   len[n-1] > len[n]
+ * which keeps the merges balanced.  A merge of two runs that are already 
+ * in order only links them.  A sorted or reverse sorted list therefore
+ * costs a single pass.  Nothing is allocated and the sort is stable.
+ */
+void NaturalMergeSort(list_t *L) {
+	sort_run_t stack[LIST_RUN_STACK];
+	list_node_t *rest;
+	int top = 0; // number of runs on the stack
+	int n;
+
+	if (L->current_list_size < 2) {
+		return;
+	}
+
+	rest = L->head;
+	while (rest != NULL) {
+		assert(top < LIST_RUN_STACK);
+		rest = CutRun(L, rest, &stack[top]);
+		top++;
+
+		// restore the invariants on the top of the stack
+		while (top > 1) {
+			n = top - 2;
+			if ((n > 0 && stack[n-1].length <= stack[n].length + stack[n+1].length)
+					|| (n > 1 && stack[n-2].length <= stack[n-1].length + stack[n].length)) {
+				if (stack[n-1].length < stack[n+1].length) {
+					n--;
+				}
+			}
+			else if (stack[n].length > stack[n+1].length) {
+				break;
+			}
+			MergeRuns(L, &stack[n], &stack[n+1]);
+			for (n = n + 1; n < top - 1; n++) {
+				stack[n] = stack[n+1];
+			}
+			top--;
+		}
+	}
+
+	// merge whatever is left, always with the smaller neighbour
+	while (top > 1) {
+		n = top - 2;
+		if (n > 0 && stack[n-1].length < stack[n+1].length) {
+			n--;
+		}
+		MergeRuns(L, &stack[n], &stack[n+1]);
+		for (n = n + 1; n < top - 1; n++) {
+			stack[n] = stack[n+1];
+		}
+		top--;
+	}
+	RelinkPrev(L, stack[0].head);
+}
+
+/* Takes the run that starts at rest off the chain and describes it in run.
+ * Returns the first node after the run.  A support function for the natural
+ * merge sort.
+ */
+list_node_t* CutRun(list_t *L, list_node_t *rest, sort_run_t *run) {
+	list_node_t *N;
+	sort_run_t extra;
+
+	run->head = rest;
+	run->tail = rest;
+	run->length = 1;
+	rest = rest->next;
+	if (rest != NULL && COMPARE(L, rest->data_ptr, run->tail->data_ptr) == 1) {
+		// strictly descending, so push each node on the front to reverse
+		while (rest != NULL && COMPARE(L, rest->data_ptr, run->head->data_ptr) == 1) {
+			N = rest;
+			rest = rest->next;
+			N->next = run->head;
+			run->head = N;
+			run->length++;
+		}
+	}
+	else {
+		while (rest != NULL && COMPARE(L, rest->data_ptr, run->tail->data_ptr) != 1) {
+			run->tail = rest;
+			rest = rest->next;
+			run->length++;
+		}
+	}
+	run->tail->next = NULL;
+
+	if (run->length < LIST_MIN_RUN && rest != NULL) {
+		// sort the next few nodes by insertion and merge them in
+		extra.head = rest;
+		rest = CutChain(rest, LIST_MIN_RUN - run->length);
+		extra.head = InsertionSortChain(L, extra.head);
+		extra.tail = extra.head;
+		extra.length = 1;
+		while (extra.tail->next != NULL) {
+			extra.tail = extra.tail->next;
+			extra.length++;
+		}
+		MergeRuns(L, run, &extra);
+	}
+	return rest;
+}
+
+/* Merges run b, which follows run a in the list, into run a.
+ *
+ * If the last node of a does not rank after the first node of b, the runs
+ * are simply joined.  If all of b ranks strictly before a, b is joined in
+ * front of a.  Otherwise the chains are merged.
+ */
+void MergeRuns(list_t *L, sort_run_t *a, sort_run_t *b) {
+	list_node_t *tail;
+
+	if (COMPARE(L, b->head->data_ptr, a->tail->data_ptr) != 1) {
+		a->tail->next = b->head;
+		a->tail = b->tail;
+	}
+	else if (COMPARE(L, b->tail->data_ptr, a->head->data_ptr) == 1) {
+		b->tail->next = a->head;
+		a->head = b->head;
+	}
+	else {
+		// ties go to a, so the last node is a's only if it ranks last
+		if (COMPARE(L, b->tail->data_ptr, a->tail->data_ptr) == 1) {
+			tail = a->tail;
+		}
+		else {
+			tail = b->tail;
+		}
+		a->head = MergeChains(L, a->head, b->head);
+		a->tail = tail;
+	}
+	a->length += b->length;
+}
+
+/* Sorts the list with a least significant digit radix sort on the integer
+ * key from key_proc.  No comparisons are made.
+ *
+ * Each pass deals the nodes, in list order, into LIST_RADIX_BUCKETS chains
+ * by one digit of the key, then joins the chains in digit order.  Passes go
+ * from the lowest digit to the highest, and each one keeps the order of 
+ * equal digits, so the result is stable.  The sign bit is flipped first so
+ * negative keys order before positive ones.  A digit that is the same in
+ * every key is skipped.  The cost is O(n) per pass with no allocation.
+ */
+void RadixSort(list_t *L) {
+	list_node_t *bucketHead[LIST_RADIX_BUCKETS];
+	list_node_t *bucketTail[LIST_RADIX_BUCKETS];
+	list_node_t front; // only front.next is used
+	list_node_t *N, *last;
+	unsigned int key, allOr = 0, allAnd = ~0u;
+	unsigned int signFlip = ~(~0u >> 1);
+	int shift, b;
+
+	if (L->current_list_size < 2) {
+		return;
+	}
+
+	// find the digits that differ between keys
+	for (N = L->head; N != NULL; N = N->next) {
+		key = (unsigned int) L->key_proc(N->data_ptr) ^ signFlip;
+		allOr |= key;
+		allAnd &= key;
+	}
+
+	front.next = L->head;
+	for (shift = 0; shift < (int) (8 * sizeof(unsigned int)); shift += LIST_RADIX_BITS) {
+		if ((((allOr ^ allAnd) >> shift) & (LIST_RADIX_BUCKETS - 1)) == 0) {
+			continue;
+		}
+		for (b = 0; b < LIST_RADIX_BUCKETS; b++) {
+			bucketHead[b] = NULL;
+		}
+		for (N = front.next; N != NULL; N = N->next) {
+			key = (unsigned int) L->key_proc(N->data_ptr) ^ signFlip;
+			b = (key >> shift) & (LIST_RADIX_BUCKETS - 1);
+			if (bucketHead[b] == NULL) {
+				bucketHead[b] = N;
+			}
+			else {
+				bucketTail[b]->next = N;
+			}
+			bucketTail[b] = N;
+		}
+		last = &front;
+		for (b = 0; b < LIST_RADIX_BUCKETS; b++) {
+			if (bucketHead[b] != NULL) {
+				last->next = bucketHead[b];
+				last = bucketTail[b];
+			}
+		}
+		last->next = NULL;
+	}
+	RelinkPrev(L, front.next);
+}
+
+/* Sorts the list by the integer key from key_proc without following a
+ * link while it sorts.
+ *
+ * One pass over the list copies each key into an array, packed with the
+ * position of its node as key * 2^32 + position, and the nodes into a 
+ * second array.  The packed keys are then sorted as plain 64 bit integers:
+ * blocks of LIST_KEY_BLOCK by a sorting network, and the blocks by merge
+ * passes into a buffer and back.  The compares of both compile to
+ * conditional moves, so they do not mispredict.  Equal keys stay in order
+ * of position, so the sort is stable.  A last pass relinks the nodes in 
+ * the order of the sorted array.
+ *
+ * Takes 16 bytes per element for the arrays, and falls back to the natural
+ * merge sort if they cannot be allocated.
+ */
+void KeySort(list_t *L) {
+	int n = L->current_list_size;
+	int64_t *keys, *buffer, *swap;
+	list_node_t **node;
+	list_node_t *N, *prev;
+	int i, width;
+
+	if (n < 2) {
+		return;
+	}
+	keys = (int64_t *) malloc(2 * (size_t) n * sizeof(int64_t));
+	node = (list_node_t **) malloc((size_t) n * sizeof(list_node_t *));
+	if (keys == NULL || node == NULL) {
+		free(keys);
+		free(node);
+		NaturalMergeSort(L);
+		return;
+	}
+	PERF_COUNT(L, mallocs);
+	PERF_COUNT(L, mallocs);
+	buffer = keys + n;
+
+	for (N = L->head, i = 0; N != NULL; N = N->next, i++) {
+		keys[i] = (int64_t) L->key_proc(N->data_ptr) * 4294967296LL + i;
+		node[i] = N;
+	}
+
+	for (i = 0; i < n; i += LIST_KEY_BLOCK) {
+		KeySortBlock(keys + i, (n - i < LIST_KEY_BLOCK) ? n - i : LIST_KEY_BLOCK);
+	}
+	for (width = LIST_KEY_BLOCK; width < n; width *= 2) {
+		for (i = 0; i < n; i += 2 * width) {
+			if (n - i <= width) {
+				memcpy(buffer + i, keys + i, (n - i) * sizeof(int64_t));
 			}
 			else {
-				list_insert(list_ptr, list_remove(lList, lList->head), NULL);
+				KeyMerge(keys + i, width, keys + i + width,
+						(n - i - width < width) ? n - i - width : width, buffer + i);
+			}
+		}
+		swap = keys;
+		keys = buffer;
+		buffer = swap;
+	}
+
+	prev = NULL;
+	for (i = 0; i < n; i++) {
+		N = node[(uint32_t) keys[i]];
+		N->prev = prev;
+		if (prev == NULL) {
+			L->head = N;
+		}
+		else {
+			prev->next = N;
+		}
+		prev = N;
+	}
+	prev->next = NULL;
+	L->tail = prev;
+
+	PERF_COUNT(L, frees);
+	PERF_COUNT(L, frees);
+	free(keys < buffer ? keys : buffer); // the start of the block
+	free(node);
+}
+
+/* Sorts count packed keys, at most LIST_KEY_BLOCK.  A full block goes 
+ * through Batcher's 19 comparator network for 8 inputs; the short block
+ * at the end of the array is insertion sorted.
+ */
+void KeySortBlock(int64_t *keys, int count) {
+	int64_t key;
+	int i, j;
+
+	if (count == 8) {
+		KEY_SORT2(keys, 0, 2); KEY_SORT2(keys, 1, 3);
+		KEY_SORT2(keys, 4, 6); KEY_SORT2(keys, 5, 7);
+		KEY_SORT2(keys, 0, 4); KEY_SORT2(keys, 1, 5);
+		KEY_SORT2(keys, 2, 6); KEY_SORT2(keys, 3, 7);
+		KEY_SORT2(keys, 0, 1); KEY_SORT2(keys, 2, 3);
+		KEY_SORT2(keys, 4, 5); KEY_SORT2(keys, 6, 7);
+		KEY_SORT2(keys, 2, 4); KEY_SORT2(keys, 3, 5);
+		KEY_SORT2(keys, 1, 4); KEY_SORT2(keys, 3, 6);
+		KEY_SORT2(keys, 1, 2); KEY_SORT2(keys, 3, 4);
+		KEY_SORT2(keys, 5, 6);
+		return;
+	}
+	for (i = 1; i < count; i++) {
+		key = keys[i];
+		for (j = i; j > 0 && keys[j - 1] > key; j--) {
+			keys[j] = keys[j - 1];
+		}
+		keys[j] = key;
+	}
+}
+
+/* Merges the sorted packed keys a and b into out.  Each step picks the
+ * smaller head with a conditional move and advances that side, so the
+ * loop has no branch that depends on the keys.  Keys are unique, so 
+ * there are no ties.
+ */
+void KeyMerge(const int64_t *a, int a_count, const int64_t *b, int b_count, int64_t *out) {
+	const int64_t *a_end = a + a_count;
+	const int64_t *b_end = b + b_count;
+	int take_b;
+
+	while (a < a_end && b < b_end) {
+		take_b = (*b < *a);
+		*out++ = take_b ? *b : *a;
+		b += take_b;
+		a += !take_b;
+	}
+	memcpy(out, a, (a_end - a) * sizeof(int64_t));
+	out += a_end - a;
+	memcpy(out, b, (b_end - b) * sizeof(int64_t));
+}
+
+/* Makes head the first node of the list and walks the next links once to
+ * set every prev link and the tail.
+ */
+void RelinkPrev(list_t *L, list_node_t *head) {
+	list_node_t *prev = NULL;
+	list_node_t *N = head;
+
+	while (N != NULL) {
+		N->prev = prev;
+		prev = N;
+		N = N->next;
+	}
+	L->head = head;
+	L->tail = prev;
+}
+
+/* Links a node that was just placed in the list into the chain of its
+ * group, next to the closest node of the same group.  The search walks out
+ * from N in both directions at once and stops at the first match.
+ */
+void GroupAdd(list_t *L, list_node_t *N) {
+	list_side_t *S = SideFind(L, N);
+	list_side_t *B;
+	int g = L->group_proc(N->data_ptr);
+	list_node_t *back = N->prev;
+	list_node_t *ahead = N->next;
+
+	assert(S->node == N);
+	assert(g >= 0 && g < L->group_count);
+	S->group = g;
+	S->group_prev = NULL;
+	S->group_next = NULL;
+	if (L->group_size[g] > 0) {
+		while (1) {
+			if (back != NULL) {
+				B = SideFind(L, back);
+				if (B->group == g) { // N goes right after back
+					S->group_prev = back;
+					S->group_next = B->group_next;
+					break;
+				}
+				back = back->prev;
+			}
+			if (ahead != NULL) {
+				B = SideFind(L, ahead);
+				if (B->group == g) { // N goes right before ahead
+					S->group_prev = B->group_prev;
+					S->group_next = ahead;
+					break;
+				}
+				ahead = ahead->next;
 			}
+			assert(back != NULL || ahead != NULL);
 		}
 	}
+	if (S->group_prev == NULL) {
+		L->group_head[g] = N;
+	}
+	else {
+		SideFind(L, S->group_prev)->group_next = N;
+	}
+	if (S->group_next == NULL) {
+		L->group_tail[g] = N;
+	}
+	else {
+		SideFind(L, S->group_next)->group_prev = N;
+	}
+	L->group_size[g]++;
 }
 
+/* Unlinks a node from the chain of its group.
+ */
+void GroupRemove(list_t *L, list_node_t *N) {
+	list_side_t *S = SideFind(L, N);
+	int g = S->group;
+
+	assert(S->node == N);
+	if (S->group_prev == NULL) {
+		L->group_head[g] = S->group_next;
+	}
+	else {
+		SideFind(L, S->group_prev)->group_next = S->group_next;
+	}
+	if (S->group_next == NULL) {
+		L->group_tail[g] = S->group_prev;
+	}
+	else {
+		SideFind(L, S->group_next)->group_prev = S->group_prev;
+	}
+	S->group_prev = NULL;
+	S->group_next = NULL;
+	S->group = -1;
+	L->group_size[g]--;
+}
+
+/* Builds every group chain again with one pass over the list, after the
+ * elements were reordered.
+ */
+void GroupRebuild(list_t *L) {
+	list_node_t *N;
+	int g;
+
+	for (g = 0; g < L->group_count; g++) {
+		L->group_head[g] = NULL;
+		L->group_tail[g] = NULL;
+		L->group_size[g] = 0;
+	}
+	for (N = L->head; N != NULL; N = N->next) {
+		GroupAppend(L, N);
+	}
+}
+
+/* Files a node in its group chain behind every node of the group already
+ * filed.  Used when nodes are filed in list order.
+ */
+void GroupAppend(list_t *L, list_node_t *N) {
+	list_side_t *S = SideFind(L, N);
+	int g = L->group_proc(N->data_ptr);
+
+	assert(S->node == N);
+	assert(g >= 0 && g < L->group_count);
+	S->group = g;
+	S->group_next = NULL;
+	S->group_prev = L->group_tail[g];
+	if (L->group_tail[g] == NULL) {
+		L->group_head[g] = N;
+	}
+	else {
+		SideFind(L, L->group_tail[g])->group_next = N;
+	}
+	L->group_tail[g] = N;
+	L->group_size[g]++;
+}
+
+/* Returns 1 if node a comes before node b in the sorted list L, else 0.
+ * Equal elements are adjacent in a sorted list, so a tie is settled by
+ * walking forward from a over the elements equal to it.
+ */
+int GroupBefore(list_t *L, list_node_t *a, list_node_t *b) {
+	int result = COMPARE(L, a->data_ptr, b->data_ptr);
+	list_node_t *N;
+
+	if (result != 0) {
+		return result == 1;
+	}
+	for (N = a->next; N != NULL && COMPARE(L, N->data_ptr, a->data_ptr) == 0; N = N->next) {
+		if (N == b) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* Walks down the skip list levels and returns the last node that ranks 
+ * before elem_ptr, or NULL if there is none.  With after_equal set, nodes
+ * equal to elem_ptr count as ranking before it, so the result is the node
+ * a new equal element goes after.  If update is not NULL, update[lvl] is
+ * set to the last tower visited on each level above the base list.
+ */
+list_node_t* SkipSearch(list_t *L, data_t *elem_ptr, int after_equal, list_skip_t **update) {
+	list_skip_t *x = NULL;
+	list_skip_t *next;
+	list_node_t *base, *base_next;
+	int lvl;
+
+	for (lvl = L->skip_levels - 1; lvl >= 1; lvl--) {
+		next = (x == NULL) ? L->skip_head[lvl] : x->next[lvl - 1];
+		while (next != NULL && SkipPasses(L, next->node, elem_ptr, after_equal)) {
+			x = next;
+			next = x->next[lvl - 1];
+		}
+		if (update != NULL) {
+			update[lvl] = x;
+		}
+	}
+	// finish on the base list, from the node under the last tower passed
+	base = (x == NULL) ? NULL : x->node;
+	base_next = (base == NULL) ? L->head : base->next;
+	while (base_next != NULL && SkipPasses(L, base_next, elem_ptr, after_equal)) {
+		base = base_next;
+		base_next = base->next;
+	}
+	return base;
+}
+
+/* Returns 1 if a search for elem_ptr moves on past node N, as described
+ * for SkipSearch, or 0 if it stops in front of N.
+ */
+int SkipPasses(list_t *L, list_node_t *N, data_t *elem_ptr, int after_equal) {
+	if (after_equal) {
+		PERF_COUNT(L, insert_visits);
+		return COMPARE(L, elem_ptr, N->data_ptr) != 1;
+	}
+	PERF_COUNT(L, find_visits);
+	return COMPARE(L, N->data_ptr, elem_ptr) == 1;
+}
+
+/* Returns the tower standing on node N, or NULL if N has none, and sets 
+ * update[lvl] to the tower in front of it on each level above the base
+ * list.  A node has no link to its tower, so this searches for the element
+ * of N, and then passes the towers of elements equal to it on level 1 
+ * until it reaches the one on N.
+ */
+list_skip_t* SkipTower(list_t *L, list_node_t *N, list_skip_t **update) {
+	list_skip_t *x = NULL;
+	list_skip_t *next;
+	int lvl;
+
+	if (L->skip_levels < 2) {
+		return NULL;
+	}
+	for (lvl = L->skip_levels - 1; lvl >= 1; lvl--) {
+		next = (x == NULL) ? L->skip_head[lvl] : x->next[lvl - 1];
+		while (next != NULL && SkipPasses(L, next->node, N->data_ptr, 0)) {
+			x = next;
+			next = x->next[lvl - 1];
+		}
+		update[lvl] = x;
+	}
+	next = (x == NULL) ? L->skip_head[1] : x->next[0];
+	while (next != NULL && next->node != N) {
+		if (COMPARE(L, next->node->data_ptr, N->data_ptr) != 0) {
+			return NULL;
+		}
+		for (lvl = 1; lvl < next->level; lvl++) {
+			update[lvl] = next;
+		}
+		next = next->next[0];
+	}
+	return next;
+}
+
+/* Gives a node just linked into the base list a random tower from the 
+ * tower pool, and links it in after the towers in update.  Levels the list
+ * did not use yet start from the head, and update must be NULL for them.
+ * Returns the tower, or NULL if the node stays on the base list only.
+ */
+list_skip_t* SkipLink(list_t *L, list_node_t *N, list_skip_t **update) {
+	list_skip_t *T;
+	int lvl;
+	int level = SkipRandomLevel(L);
+
+	if (level == 1) {
+		return NULL;
+	}
+	if (L->skip_pool == NULL) {
+		L->skip_pool = PoolCreate(0);
+	}
+	PERF_COUNT(L, pool_allocs);
+	T = (list_skip_t *) PoolAlloc(L->skip_pool, LIST_POOL_TOWER + level - 2);
+	T->node = N;
+	T->level = level;
+	if (level > L->skip_levels) {
+		for (lvl = L->skip_levels; lvl < level; lvl++) {
+			L->skip_head[lvl] = NULL;
+		}
+		L->skip_levels = level;
+	}
+	for (lvl = 1; lvl < level; lvl++) {
+		if (update[lvl] == NULL) {
+			T->next[lvl - 1] = L->skip_head[lvl];
+			L->skip_head[lvl] = T;
+		}
+		else {
+			T->next[lvl - 1] = update[lvl]->next[lvl - 1];
+			update[lvl]->next[lvl - 1] = T;
+		}
+	}
+	return T;
+}
+
+/* Unlinks the tower of a node that is leaving the list, if it has one, and
+ * returns it to the tower pool.  Finding it costs a search, expected
+ * O(log n).
+ */
+void SkipUnlink(list_t *L, list_node_t *N) {
+	list_skip_t *update[LIST_SKIP_LEVELS];
+	list_skip_t *T = SkipTower(L, N, update);
+	int lvl;
+
+	if (T == NULL) {
+		return;
+	}
+	for (lvl = 1; lvl < T->level; lvl++) {
+		if (update[lvl] == NULL) {
+			L->skip_head[lvl] = T->next[lvl - 1];
+		}
+		else {
+			update[lvl]->next[lvl - 1] = T->next[lvl - 1];
+		}
+	}
+	PERF_COUNT(L, pool_frees);
+	PoolFree(L->skip_pool, LIST_POOL_TOWER + T->level - 2, T);
+}
+
+/* Removes the skip list from L.  Every tower is in the tower pool of L, so
+ * they are freed with its slabs without visiting any node.
+ */
+void SkipClear(list_t *L) {
+	if (L->skip_pool != NULL) {
+		PoolRelease(L->skip_pool);
+		L->skip_pool = NULL;
+	}
+	L->skip_levels = 0;
+}
+
+/* Builds a skip list over the sorted list L with one pass over it, giving
+ * each node a random tower.
+ */
+void SkipRebuild(list_t *L) {
+	list_skip_t *last[LIST_SKIP_LEVELS];
+	list_skip_t *T;
+	list_node_t *N;
+	int lvl;
+
+	for (lvl = 0; lvl < LIST_SKIP_LEVELS; lvl++) {
+		last[lvl] = NULL;
+	}
+	L->skip_levels = 1;
+	for (N = L->head; N != NULL; N = N->next) {
+		// the last tower of every level sits before N, like a sorted insert
+		T = SkipLink(L, N, last);
+		for (lvl = 1; T != NULL && lvl < T->level; lvl++) {
+			last[lvl] = T;
+		}
+	}
+}
+
+/* Returns a random tower height from 1 to LIST_SKIP_LEVELS - 1, each level
+ * kept with chance 1 / LIST_SKIP_PROMOTE.  Uses a xorshift generator kept
+ * in the list.
+ */
+int SkipRandomLevel(list_t *L) {
+	int level = 1;
+	unsigned int x = L->skip_seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	L->skip_seed = x;
+	while (level < LIST_SKIP_LEVELS - 1 && x % LIST_SKIP_PROMOTE == 0) {
+		level++;
+		x /= LIST_SKIP_PROMOTE;
+	}
+	return level;
+}
+
+/* Adds a node that was just linked into L to the group column.  A node at
+ * the tail goes in the next slot; anywhere else it would shift the slots
+ * after it, so the column is left to be built again.
+ */
+void ColumnAdd(list_t *L, list_node_t *N) {
+	int g;
+
+	if (L->column_dirty || N->next != NULL) {
+		L->column_dirty = 1;
+		return;
+	}
+	if (L->column_len == L->column_cap) {
+		L->column_cap *= 2;
+		L->column = (unsigned char *) realloc(L->column, L->column_cap);
+		L->column_node = (list_node_t **) realloc(L->column_node,
+				L->column_cap * sizeof(list_node_t *));
+	}
+	g = L->column_proc(N->data_ptr);
+	assert(g >= 0 && g < L->column_groups);
+	SideFind(L, N)->column_slot = L->column_len;
+	L->column[L->column_len] = (unsigned char) g;
+	L->column_node[L->column_len] = N;
+	L->column_len++;
+}
+
+/* Marks the slot of a node that is leaving L as empty.  Once more than
+ * half of the slots are empty the column is left to be built again.
+ */
+void ColumnRemove(list_t *L, list_node_t *N) {
+	if (L->column_dirty) {
+		return;
+	}
+	L->column[SideFind(L, N)->column_slot] = LIST_COLUMN_GROUPS;
+	if (L->column_len > 2 * L->current_list_size + LIST_COLUMN_MIN) {
+		L->column_dirty = 1;
+	}
+}
+
+/* Builds the group column again with one pass over the list.
+ */
+void ColumnRebuild(list_t *L) {
+	list_node_t *N;
+	int cap = L->column_cap;
+
+	while (cap < L->current_list_size) {
+		cap *= 2;
+	}
+	if (cap != L->column_cap) {
+		L->column_cap = cap;
+		L->column = (unsigned char *) realloc(L->column, cap);
+		L->column_node = (list_node_t **) realloc(L->column_node,
+				cap * sizeof(list_node_t *));
+	}
+	L->column_len = 0;
+	L->column_dirty = 0;
+	for (N = L->head; N != NULL; N = N->next) {
+		SideFind(L, N)->column_slot = L->column_len;
+		L->column[L->column_len] = (unsigned char) L->column_proc(N->data_ptr);
+		L->column_node[L->column_len] = N;
+		L->column_len++;
+	}
+}
+
+/* Replaces the side table of L with an empty table of 1 << bits slots.
+ */
+void SideReset(list_t *L, int bits) {
+	free(L->side_table);
+	L->side_table = (list_side_t *) calloc((size_t) 1 << bits, sizeof(list_side_t));
+	L->side_bits = bits;
+	L->side_used = 0;
+}
+
+/* Returns the slot of the side table holding node N, or the empty slot
+ * where it would go.  Like the hash index, the table uses linear probing
+ * and is never full.
+ */
+list_side_t* SideFind(list_t *L, list_node_t *N) {
+	unsigned int mask = (1u << L->side_bits) - 1;
+	unsigned int i = SIDE_HOME(L, N);
+
+	while (L->side_table[i].node != NULL && L->side_table[i].node != N) {
+		i = (i + 1) & mask;
+	}
+	return &L->side_table[i];
+}
+
+/* Enters a node that was just linked into L into the side table, in no 
+ * group and no column slot, and returns its slot.  The table grows first
+ * if it must, so the slot stays put until the next SideAdd or SideRemove.
+ */
+list_side_t* SideAdd(list_t *L, list_node_t *N) {
+	list_side_t *old, *slot;
+	int i, oldBits;
+
+	if (2 * (L->side_used + 1) > (1 << L->side_bits)) {
+		// grow: move every slot into a table twice the size
+		old = L->side_table;
+		oldBits = L->side_bits;
+		L->side_table = NULL;
+		SideReset(L, oldBits + 1);
+		for (i = 0; i < (1 << oldBits); i++) {
+			if (old[i].node != NULL) {
+				*SideFind(L, old[i].node) = old[i];
+				L->side_used++;
+			}
+		}
+		free(old);
+	}
+	slot = SideFind(L, N);
+	assert(slot->node == NULL);
+	slot->node = N;
+	slot->group_prev = NULL;
+	slot->group_next = NULL;
+	slot->group = -1;
+	slot->column_slot = -1;
+	L->side_used++;
+	return slot;
+}
+
+/* Takes a node that is leaving L out of the side table, after it left the
+ * group chains.  An emptied slot is filled by shifting back the entries
+ * that probed past it, as in HashRemove.
+ */
+void SideRemove(list_t *L, list_node_t *N) {
+	unsigned int mask = (1u << L->side_bits) - 1;
+	list_side_t *slot = SideFind(L, N);
+	unsigned int hole, i, home;
+
+	assert(slot->node == N);
+	L->side_used--;
+	hole = (unsigned int) (slot - L->side_table);
+	i = hole;
+	while (1) {
+		i = (i + 1) & mask;
+		if (L->side_table[i].node == NULL) {
+			break;
+		}
+		home = SIDE_HOME(L, L->side_table[i].node);
+		// move the entry back unless its home lies cyclically in (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			L->side_table[hole] = L->side_table[i];
+			hole = i;
+		}
+	}
+	L->side_table[hole].node = NULL;
+}
+
+/* Replaces the hash index of L with an empty table of 1 << bits slots.
+ */
+void HashReset(list_t *L, int bits) {
+	free(L->hash_table);
+	L->hash_table = (list_hash_slot_t *) calloc((size_t) 1 << bits, sizeof(list_hash_slot_t));
+	L->hash_bits = bits;
+	L->hash_keys = 0;
+}
+
+/* Builds the hash index of L again from the elements in the list, with a
+ * table large enough to hold them.
+ */
+void HashRebuild(list_t *L) {
+	list_node_t *N;
+	int bits = LIST_HASH_MIN_BITS;
+
+	while ((1 << bits) < 2 * L->current_list_size) {
+		bits++;
+	}
+	HashReset(L, bits);
+	for (N = L->head; N != NULL; N = N->next) {
+		HashAdd(L, N);
+	}
+}
+
+/* Returns the slot of the hash index holding key, or the empty slot where
+ * it would go.  The table uses linear probing, and is never full.
+ */
+list_hash_slot_t* HashFind(list_t *L, int key) {
+	unsigned int mask = (1u << L->hash_bits) - 1;
+	// multiplicative hashing: the top bits of the product are well mixed
+	unsigned int i = ((unsigned int) key * 2654435761u) >> (32 - L->hash_bits);
+
+	while (L->hash_table[i].count != 0 && L->hash_table[i].key != key) {
+		i = (i + 1) & mask;
+	}
+	return &L->hash_table[i];
+}
+
+/* Enters the node into the hash index.  A key that was already present is
+ * no longer tied to a single node.
+ */
+void HashAdd(list_t *L, list_node_t *N) {
+	int key = L->key_proc(N->data_ptr);
+	list_hash_slot_t *slot = HashFind(L, key);
+	list_hash_slot_t *old;
+	int i, oldBits;
+
+	if (slot->count > 0) {
+		slot->count++;
+		slot->node = NULL;
+		return;
+	}
+	slot->key = key;
+	slot->count = 1;
+	slot->node = N;
+	L->hash_keys++;
+
+	if (2 * L->hash_keys > (1 << L->hash_bits)) {
+		// grow: move every slot into a table twice the size
+		old = L->hash_table;
+		oldBits = L->hash_bits;
+		L->hash_table = NULL;
+		HashReset(L, oldBits + 1);
+		for (i = 0; i < (1 << oldBits); i++) {
+			if (old[i].count > 0) {
+				*HashFind(L, old[i].key) = old[i];
+				L->hash_keys++;
+			}
+		}
+		free(old);
+	}
+}
+
+/* Takes the node, which is still in the list, out of the hash index.  An
+ * emptied slot is filled by shifting back the entries that probed past it,
+ * so the table needs no tombstones.
+ */
+void HashRemove(list_t *L, list_node_t *N) {
+	unsigned int mask = (1u << L->hash_bits) - 1;
+	list_hash_slot_t *slot = HashFind(L, L->key_proc(N->data_ptr));
+	unsigned int hole, i, home;
+
+	assert(slot->count > 0);
+	if (--slot->count > 0) {
+		// the remaining elements are found by a scan of the list
+		slot->node = NULL;
+		return;
+	}
+	L->hash_keys--;
+
+	hole = (unsigned int) (slot - L->hash_table);
+	i = hole;
+	while (1) {
+		i = (i + 1) & mask;
+		if (L->hash_table[i].count == 0) {
+			break;
+		}
+		home = ((unsigned int) L->hash_table[i].key * 2654435761u) >> (32 - L->hash_bits);
+		// move the entry back unless its home lies cyclically in (hole, i]
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			L->hash_table[hole] = L->hash_table[i];
+			hole = i;
+		}
+	}
+	L->hash_table[hole].count = 0;
+	L->hash_table[hole].node = NULL;
+}
+
+/* Creates an empty pool.  Each size class is carved from its own slabs so
+ * blocks of one class are packed together.  An intrusive pool hands out
+ * whole list_rec_t blocks as its elements and no separate nodes.  The 
+ * tower classes are used by the tower pool of a LIST_SKIP list.
+ */
+list_pool_t* PoolCreate(int mode) {
+	list_pool_t *P = (list_pool_t *) malloc(sizeof(list_pool_t));
+	int c;
+	size_t align = sizeof(void *);
+
+	P->slab_chain = NULL;
+	P->block_size[LIST_POOL_NODE] = sizeof(list_node_t);
+	P->block_size[LIST_POOL_ELEM] = sizeof(data_t);
+	if (mode & LIST_INTRUSIVE) {
+		P->block_size[LIST_POOL_ELEM] = sizeof(list_rec_t);
+	}
+	P->slab_blocks[LIST_POOL_NODE] = LIST_SLAB_BLOCKS;
+	P->slab_blocks[LIST_POOL_ELEM] = LIST_SLAB_BLOCKS;
+	for (c = LIST_POOL_TOWER; c < LIST_POOL_CLASSES; c++) {
+		// a tower of height c - LIST_POOL_TOWER + 2 links the levels above
+		// the base list
+		P->block_size[c] = offsetof(list_skip_t, next) 
+				+ (c - LIST_POOL_TOWER + 1) * sizeof(list_skip_t *);
+		P->slab_blocks[c] = (c == LIST_POOL_TOWER) ? LIST_SLAB_BLOCKS
+				: P->slab_blocks[c - 1] / LIST_SKIP_PROMOTE;
+		if (P->slab_blocks[c] < LIST_SLAB_MIN_BLOCKS) {
+			P->slab_blocks[c] = LIST_SLAB_MIN_BLOCKS;
+		}
+	}
+	for (c = 0; c < LIST_POOL_CLASSES; c++) {
+		// a free block holds the free list link, so round up to a pointer
+		P->block_size[c] = (P->block_size[c] + align - 1) / align * align;
+		P->free_block[c] = NULL;
+		P->bump_next[c] = NULL;
+		P->bump_end[c] = NULL;
+	}
+	P->ref_count = 1;
+	P->locked = (mode & (LIST_LOCKED | LIST_INBOX)) ? 1 : 0;
+	pthread_mutex_init(&P->lock, NULL);
+	return P;
+}
+
+/* Drops one reference to the pool.  The last reference frees every slab,
+ * which also frees every block still handed out from them.
+ */
+void PoolRelease(list_pool_t *P) {
+	void *slab, *nextSlab;
+
+	assert(P->ref_count > 0);
+	if (--P->ref_count > 0) {
+		return;
+	}
+	slab = P->slab_chain;
+	while (slab != NULL) {
+		nextSlab = *(void **) slab;
+		free(slab);
+		slab = nextSlab;
+	}
+	pthread_mutex_destroy(&P->lock);
+	free(P);
+}
+
+/* Hands out one block of the given class.  Recycled blocks are used first,
+ * then the unused tail of the newest slab, and only then is a new slab
+ * allocated.  The pool of a LIST_LOCKED or LIST_INBOX list is only used 
+ * under its mutex, since lists locked separately, and producers pushing
+ * without a lock, may share it.
+ */
+void* PoolAlloc(list_pool_t *P, int block_class) {
+	void *block;
+	size_t size = P->block_size[block_class];
+
+	if (P->locked) {
+		pthread_mutex_lock(&P->lock);
+	}
+	block = P->free_block[block_class];
+	if (block != NULL) {
+		P->free_block[block_class] = *(void **) block;
+	}
+	else {
+		if (P->bump_next[block_class] == P->bump_end[block_class]) {
+			// first word of the slab links the chain, the blocks follow it
+			size_t length = size * P->slab_blocks[block_class];
+			char *slab = (char *) malloc(sizeof(void *) + length);
+			*(void **) slab = P->slab_chain;
+			P->slab_chain = slab;
+			P->bump_next[block_class] = slab + sizeof(void *);
+			P->bump_end[block_class] = P->bump_next[block_class] + length;
+		}
+		block = P->bump_next[block_class];
+		P->bump_next[block_class] += size;
+	}
+	if (P->locked) {
+		pthread_mutex_unlock(&P->lock);
+	}
+	return block;
+}
+
+/* Pushes a block back on the free list of its class.
+ */
+void PoolFree(list_pool_t *P, int block_class, void *block) {
+	if (P->locked) {
+		pthread_mutex_lock(&P->lock);
+	}
+	*(void **) block = P->free_block[block_class];
+	P->free_block[block_class] = block;
+	if (P->locked) {
+		pthread_mutex_unlock(&P->lock);
+	}
+}
+
+/* Gets a node for the element from the list allocator.  The links are not
+ * set.  An intrusive element already sits in its node, which is returned.
+ */
+list_node_t* NodeAlloc(list_t *L, data_t *elem_ptr) {
+	list_node_t *N;
+
+	if (L->mode & LIST_INTRUSIVE) {
+		N = &REC_OF(elem_ptr)->node;
+	}
+	else if (L->pool != NULL) {
+		PERF_COUNT(L, pool_allocs);
+		N = (list_node_t *) PoolAlloc(L->pool, LIST_POOL_NODE);
+	}
+	else {
+		PERF_COUNT(L, mallocs);
+		N = (list_node_t *) malloc(sizeof(list_node_t));
+	}
+	N->data_ptr = elem_ptr;
+	return N;
+}
+
+/* Links a node that is in no list into list_ptr in front of idx_ptr, or at
+ * the tail if idx_ptr is NULL, and files it in the indexes.  The body of
+ * list_insert, shared with list_transfer.
+ */
+void NodeLink(list_t *list_ptr, list_node_t *newNode, list_node_t *idx_ptr)
+{
+	 newNode->next = NULL;
+	 newNode->prev = NULL;
+	 if (list_ptr->hash_table != NULL) {
+		 HashAdd(list_ptr, newNode);
+	 }
+
+	// if list empty, new node both head and tail
+	 if (list_ptr->current_list_size == 0) {
+		 list_ptr->head = newNode;
+		 list_ptr->tail = newNode;
+	 }
+	 // want it in back of list
+	 else if (idx_ptr == NULL) { 
+		 list_ptr->tail->next = newNode;
+		 newNode->prev = list_ptr->tail;
+		 list_ptr->tail = newNode; 
+	 }
+		 // want it before idx_ptr
+	 else { 
+		 newNode->prev = idx_ptr->prev;
+		 newNode->next = idx_ptr;
+		 idx_ptr->prev = newNode;
+		 if (idx_ptr == list_ptr->head) {
+			 list_ptr->head = newNode;
+		 }
+		 // this may cause issues if idx_ptr is head, so it is put here
+		 else {
+			 newNode->prev->next = newNode;
+		 }
+	 }
+	 list_ptr->current_list_size++;
+	 if (list_ptr->side_table != NULL) {
+		 SideAdd(list_ptr, newNode);
+	 }
+	 if (list_ptr->group_count > 0) {
+		 GroupAdd(list_ptr, newNode);
+	 }
+	 if (list_ptr->column != NULL) {
+		 ColumnAdd(list_ptr, newNode);
+	 }
+
+	 if (list_ptr->skip_levels > 0) {
+		 SkipClear(list_ptr); // the skip list only works on a sorted list
+	 }
+
+    // the last two lines of this function must be the following 
+    if (list_ptr->list_sorted_state == SORTED_LIST) 
+	list_ptr->list_sorted_state = UNSORTED_LIST;
+    // list_debug_validate(list_ptr);
+}
+
+/* Links a node that is in no list into the sorted list_ptr after all the
+ * elements that do not rank after it, and files it in the indexes.  The
+ * body of list_insert_sorted, shared with list_transfer_sorted.
+ */
+void NodeLinkSorted(list_t *list_ptr, list_node_t *newNode)
+{
+	 data_t *elem_ptr = newNode->data_ptr;
+	 list_skip_t *update[LIST_SKIP_LEVELS] = { NULL };
+
+	 newNode->next = NULL;
+	 newNode->prev = NULL;
+
+	 if (list_ptr->hash_table != NULL) {
+		 HashAdd(list_ptr, newNode);
+	 }
+
+	 // if list empty, need to assign this as head and tail.
+	 if (list_ptr->current_list_size == 0) {
+		 list_ptr->head = newNode;
+		 list_ptr->tail = newNode;
+		 list_ptr->current_list_size++;
+		 if (list_ptr->side_table != NULL) {
+			 SideAdd(list_ptr, newNode);
+		 }
+		 if (list_ptr->group_count > 0) {
+			 GroupAdd(list_ptr, newNode);
+		 }
+		 if (list_ptr->column != NULL) {
+			 ColumnAdd(list_ptr, newNode);
+		 }
+		 if (list_ptr->skip_levels > 0) {
+			 SkipLink(list_ptr, newNode, update);
+		 }
+		 
+		 // list_debug_validate(list_ptr);
+		 return;
+	 }
+
+	 IteratorPtr N = list_ptr->head;
+	 int result = 0; // for value of comp_proc
+	 int inserted = 0; // 0 for not inserted, 1 for inserted
+
+	 if (list_ptr->skip_levels > 0) {
+		 // start the scan at the first element that ranks after elem_ptr
+		 N = SkipSearch(list_ptr, elem_ptr, 1, update);
+		 N = (N == NULL) ? list_ptr->head : N->next;
+	 }
+
+	 while (N != NULL) {
+		 PERF_COUNT(list_ptr, insert_visits);
+		 result = COMPARE(list_ptr, elem_ptr, N->data_ptr);
+		 if (result == 1) { // put it before N
+			 if (N == list_ptr->head) {
+				 newNode->next = N;
+				 N->prev = newNode;
+				 list_ptr->head = newNode;
+				 N = NULL; // make loop end
+			 }
+			 else {
+				 newNode->next = N;
+				 newNode->prev = N->prev;
+				 N->prev->next = newNode;
+				 N->prev = newNode;
+				 N = NULL; // make loop end
+			 }
+			 inserted = 1;
+		 }
+		 if (result == -1) { // keep looking through list
+			 N = N->next;
+		 }
+		 if (result == 0) {
+			 N = N->next; // so it will go after entries of equal rank
+		 }
+	 }
+
+	 if (inserted == 0) { // was not inserted, so put at back
+		 list_ptr->tail->next = newNode;
+		 newNode->prev = list_ptr->tail;
+		 list_ptr->tail = newNode;
+	 }
+
+	 list_ptr->current_list_size++;
+	 if (list_ptr->side_table != NULL) {
+		 SideAdd(list_ptr, newNode);
+	 }
+	 if (list_ptr->group_count > 0) {
+		 GroupAdd(list_ptr, newNode);
+	 }
+	 if (list_ptr->column != NULL) {
+		 ColumnAdd(list_ptr, newNode);
+	 }
+	 if (list_ptr->skip_levels > 0) {
+		 SkipLink(list_ptr, newNode, update);
+	 }
+
+    // list_debug_validate(list_ptr);
+}
+
+/* Takes a node out of list_ptr and out of its indexes without freeing it.
+ * The node keeps its element.  The body of list_remove, shared with 
+ * list_transfer.
+ */
+void NodeUnlink(list_t *list_ptr, list_node_t *idx_ptr)
+{
+	 if (list_ptr->hash_table != NULL) {
+		 HashRemove(list_ptr, idx_ptr);
+	 }
+	 if (list_ptr->group_count > 0) {
+		 GroupRemove(list_ptr, idx_ptr);
+	 }
+	 if (list_ptr->column != NULL) {
+		 ColumnRemove(list_ptr, idx_ptr);
+	 }
+	 if (list_ptr->skip_levels > 0) {
+		 SkipUnlink(list_ptr, idx_ptr);
+	 }
+	 if (list_ptr->side_table != NULL) {
+		 SideRemove(list_ptr, idx_ptr);
+	 }
+	 // if only 1 entry, handle differently
+	 if (1 == list_ptr->current_list_size) {
+		 list_ptr->head = NULL;
+		 list_ptr->tail = NULL;
+	 }
+	 else if (idx_ptr == list_ptr->head) {
+		 list_ptr->head = idx_ptr->next; // if front removed, select new head
+		 list_ptr->head->prev = NULL;
+	 }
+	 else if (idx_ptr == list_ptr->tail) {
+		 list_ptr->tail = idx_ptr->prev; // if back removed, select new tail
+		 list_ptr->tail->next = NULL;
+	 }
+	 else { // removing entry in middle
+		 // skip over removed entry
+		 idx_ptr->prev->next = idx_ptr->next;
+		 idx_ptr->next->prev = idx_ptr->prev;
+	 }
+	 idx_ptr->prev = NULL;
+	 idx_ptr->next = NULL;
+	 list_ptr->current_list_size--;
+}
+
+/* Hands a node taken out of src_ptr over to dest_ptr.  The node itself is
+ * returned when the two lists share an allocator, otherwise it is freed 
+ * and a node from dest_ptr carries the element instead.
+ */
+list_node_t* NodeMove(list_t *dest_ptr, list_t *src_ptr, list_node_t *N) {
+	data_t *elem_ptr;
+
+	if (NodeShared(dest_ptr, src_ptr)) {
+		return N;
+	}
+	elem_ptr = N->data_ptr;
+	NodeFree(src_ptr, N);
+	return NodeAlloc(dest_ptr, elem_ptr);
+}
+
+/* Returns 1 if a node of list A can be linked into list B as it is, 
+ * because both lists take their nodes from the same place.
+ */
+int NodeShared(list_t *A, list_t *B) {
+	return (A->mode & LIST_ALLOC_FLAGS) == (B->mode & LIST_ALLOC_FLAGS) 
+			&& A->pool == B->pool;
+}
+
+/* Returns a node that is no longer linked into the list.  An intrusive
+ * node stays with its element, which now belongs to the caller.
+ */
+void NodeFree(list_t *L, list_node_t *N) {
+	if (L->mode & LIST_INTRUSIVE) {
+		return;
+	}
+	if (L->pool != NULL) {
+		PERF_COUNT(L, pool_frees);
+		PoolFree(L->pool, LIST_POOL_NODE, N);
+	}
+	else {
+		PERF_COUNT(L, frees);
+		free(N);
+	}
+}
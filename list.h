@@ -3,6 +3,8 @@
  * Public functions for two-way linked list
  */
 
+#include <pthread.h>
+
 typedef struct list_node_tag {
     // private members for list.c only
     data_t *data_ptr;
@@ -10,14 +12,145 @@ typedef struct list_node_tag {
     struct list_node_tag *next;
 } list_node_t;
 
+// a node with its record inline, used by LIST_INTRUSIVE lists 
+typedef struct list_rec_tag {
+    // private members for list.c only
+    list_node_t node;     // node.data_ptr points at data below
+    data_t data;
+} list_rec_t;
+
+// mode flags for list_construct_mode, or'ed together
+#define LIST_MALLOC    0x0   // each node from malloc, returned with free
+#define LIST_POOL      0x1   // nodes and records carved from shared slabs
+#define LIST_INTRUSIVE 0x2   // record stored inline in its node, one block
+#define LIST_HASH      0x4   // hash index on key_proc for list_elem_find
+#define LIST_SKIP      0x8   // skip list levels while the list is sorted
+#define LIST_LOCKED    0x10  // reader/writer lock taken with list_lock
+#define LIST_INBOX     0x20  // lock-free list_push from any thread
+#define LIST_ALLOC_FLAGS (LIST_POOL | LIST_INTRUSIVE)
+
+// levels of the skip list, counting the base list as level 0
+#define LIST_SKIP_LEVELS 16
+
+// size classes handed out by a list_pool_t: nodes, elements, and skip list
+// towers with one class for each height from 2 to LIST_SKIP_LEVELS - 1
+#define LIST_POOL_NODE    0
+#define LIST_POOL_ELEM    1
+#define LIST_POOL_TOWER   2
+#define LIST_POOL_CLASSES (LIST_POOL_TOWER + LIST_SKIP_LEVELS - 2)
+
+typedef struct list_pool_tag {
+    // private members for list.c only
+    void *slab_chain;                       // every slab, freed together
+    void *free_block[LIST_POOL_CLASSES];    // recycled blocks per class
+    char *bump_next[LIST_POOL_CLASSES];     // uncarved part of newest slab
+    char *bump_end[LIST_POOL_CLASSES];
+    size_t block_size[LIST_POOL_CLASSES];
+    int slab_blocks[LIST_POOL_CLASSES];     // blocks carved from each slab
+    int ref_count;                          // lists sharing this pool
+    int locked;                             // 1 if a LIST_LOCKED or LIST_INBOX
+                                            // list uses it
+    pthread_mutex_t lock;                   // held by PoolAlloc and PoolFree
+} list_pool_t;
+
+// one slot of the open addressing hash index of a LIST_HASH list 
+typedef struct list_hash_slot_tag {
+    // private members for list.c only
+    list_node_t *node;    // the element, NULL if several share the key
+    int key;
+    int count;            // elements with this key, 0 for an empty slot
+} list_hash_slot_t;
+
+// the most groups a group column holds; LIST_COLUMN_GROUPS marks the slot
+// of a removed node
+#define LIST_COLUMN_GROUPS 255
+
+// a tower of a LIST_SKIP list: the links of one node on the levels above
+// the base list, kept apart from the node in the tower pool of the list
+typedef struct list_skip_tag {
+    // private members for list.c only
+    list_node_t *node;              // the node the tower stands on
+    int level;                      // height, counting the base list
+    struct list_skip_tag *next[];   // next tower on levels 1 to level - 1
+} list_skip_t;
+
+// what the group index and the group column keep for one node, in a slot
+// of an open addressing table of the list found by the node address
+typedef struct list_side_tag {
+    // private members for list.c only
+    list_node_t *node;          // NULL for an empty slot
+    list_node_t *group_prev;    // chain of the nodes in the same group,
+    list_node_t *group_next;    // in list order
+    int group;
+    int column_slot;            // slot of the node in the group column
+} list_side_t;
+
+// how list_lock and list_lock_pair lock a LIST_LOCKED list
+#define LIST_READ  0
+#define LIST_WRITE 1
+
+// sort types accepted by list_sort are 1 to LIST_SORT_TYPES
+#define LIST_SORT_TYPES 10
+
+// operation counts of a list, only kept when list.c is compiled with 
+// LIST_PERF defined (make PERF=1)
+typedef struct list_perf_tag {
+    unsigned long comparisons;     // calls to comp_proc
+    unsigned long find_visits;     // nodes compared by list_elem_find
+    unsigned long insert_visits;   // nodes compared by list_insert_sorted
+    unsigned long mallocs;         // blocks from malloc
+    unsigned long frees;           // blocks returned with free
+    unsigned long pool_allocs;     // blocks from the slab pool
+    unsigned long pool_frees;      // blocks returned to the slab pool
+    unsigned long sorts[LIST_SORT_TYPES + 1];   // list_sort calls by type, 
+                                                // 0 for an invalid type
+} list_perf_t;
+
 typedef struct list_tag {
     // private members for list.c only
     list_node_t *head;
     list_node_t *tail;
     int current_list_size;
     int list_sorted_state;
+    int mode;
+    list_pool_t *pool;    // NULL unless mode has LIST_POOL
+    list_hash_slot_t *hash_table;   // NULL unless mode has LIST_HASH
+    int hash_bits;        // the table has 1 << hash_bits slots
+    int hash_keys;        // slots in use
+    int group_count;      // 0 unless list_set_groups was called
+    list_node_t **group_head;
+    list_node_t **group_tail;
+    int *group_size;
+    list_side_t *side_table;    // every node, NULL unless the list has a
+                                // group index or a group column
+    int side_bits;        // the table has 1 << side_bits slots
+    int side_used;        // slots in use
+    int skip_levels;      // levels in use, 0 while there is no skip list
+    list_skip_t *skip_head[LIST_SKIP_LEVELS];
+    list_pool_t *skip_pool;     // the towers, NULL while there are none
+    unsigned int skip_seed;   // random number state for tower heights
+    int sort_threads;     // threads for the parallel sort, 0 for all CPUs
+    unsigned char *column;      // group of each node, in list order, 
+                                // NULL unless list_set_column was called
+    list_node_t **column_node;  // the node of each slot of the column
+    int column_len;       // slots in use, including removed ones
+    int column_cap;
+    int column_dirty;     // 1 when the column must be built again
+    int column_groups;
+    list_node_t **column_match; // the result of list_column_match, kept
+    int column_match_cap;       // for the next one
+#ifdef LIST_PERF
+    list_perf_t perf;
+#endif
     // Private method for list.c only
     int (*comp_proc) (const data_t *, const data_t *);
+    int (*key_proc) (const data_t *);
+    int (*group_proc) (const data_t *);
+    int (*column_proc) (const data_t *);
+    pthread_rwlock_t lock;      // only used if mode has LIST_LOCKED
+    list_node_t *inbox;         // nodes from list_push, newest first, 
+                                // until list_drain links them
+    int inbox_count;            // pushes not yet drained
 } list_t;
 
 // public definition of pointer into linked list 
@@ -28,8 +161,14 @@ typedef list_t * ListPtr;
 
 // build and cleanup lists 
 ListPtr list_construct(int (*fcomp)(const data_t *, const data_t *));
+ListPtr list_construct_mode(int (*fcomp)(const data_t *, const data_t *),
+        int (*fkey)(const data_t *), int mode, ListPtr peer_ptr);
 void list_destruct(ListPtr list_ptr);
 
+// records owned by the list allocator 
+data_t * list_elem_alloc(ListPtr list_ptr);
+void list_elem_free(ListPtr list_ptr, data_t *elem_ptr);
+
 // iterators into positions in the list 
 IteratorPtr list_iter_front(ListPtr list_ptr);
 IteratorPtr list_iter_back(ListPtr list_ptr);
@@ -40,10 +179,49 @@ IteratorPtr list_elem_find(ListPtr list_ptr, data_t *elem_ptr);
 
 void list_insert(ListPtr list_ptr, data_t *elem_ptr, IteratorPtr idx_ptr);
 void list_insert_sorted(ListPtr list_ptr, data_t *elem_ptr);
+void list_merge_sorted(ListPtr dest_ptr, ListPtr src_ptr, int count);
+void list_append_bulk(ListPtr list_ptr, const data_t *elem_array, int count, int sorted);
+
+// move nodes between lists without allocating 
+void list_transfer(ListPtr dest_ptr, IteratorPtr dest_idx, ListPtr src_ptr, IteratorPtr src_idx);
+void list_transfer_sorted(ListPtr dest_ptr, ListPtr src_ptr, IteratorPtr src_idx);
+void list_splice(ListPtr dest_ptr, ListPtr src_ptr);
+void list_split(ListPtr list_ptr, IteratorPtr idx_ptr, ListPtr rest_ptr);
 
 void list_sort(ListPtr list_ptr, int sort_type);
+void list_set_sort_threads(ListPtr list_ptr, int sort_threads);
 
 data_t * list_remove(ListPtr list_ptr, IteratorPtr idx_ptr);
 
+// secondary index: one chain per group, each in list order 
+void list_set_groups(ListPtr list_ptr, int (*fgroup)(const data_t *), int group_count);
+int list_group_count(ListPtr list_ptr);
+int list_group_size(ListPtr list_ptr, int group);
+IteratorPtr list_group_front(ListPtr list_ptr, int group);
+IteratorPtr list_group_next(ListPtr list_ptr, IteratorPtr idx_ptr);
+void list_group_retag(ListPtr list_ptr, int old_group, int new_group);
+
+// operation counters, see list_perf_t 
+int list_perf_read(ListPtr list_ptr, list_perf_t *perf_ptr);
+void list_perf_reset(ListPtr list_ptr);
+
+// group column: the group of every element in one array, scanned with SIMD 
+void list_set_column(ListPtr list_ptr, int (*fgroup)(const data_t *), int group_count);
+int list_column_groups(ListPtr list_ptr);
+IteratorPtr *list_column_match(ListPtr list_ptr, int group, int *count);
+void list_column_retag(ListPtr list_ptr, int old_group, int new_group);
+
+// locking of LIST_LOCKED lists, no-ops for other lists 
+void list_lock(ListPtr list_ptr, int how);
+void list_unlock(ListPtr list_ptr);
+void list_lock_pair(ListPtr a_ptr, ListPtr b_ptr, int how);
+void list_unlock_pair(ListPtr a_ptr, ListPtr b_ptr);
+
+// multi-producer tail inserts of LIST_INBOX lists, drained by one consumer 
+int list_push(ListPtr list_ptr, data_t *elem_ptr);
+int list_drain(ListPtr list_ptr);
+int list_pending(ListPtr list_ptr);
+
 int list_size(ListPtr list_ptr);
+int list_is_sorted(ListPtr list_ptr);
 
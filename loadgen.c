@@ -0,0 +1,286 @@
+/* loadgen.c
+ * MP3
+ *
+ * Purpose: Load generator for the server mode of lab3 (lab3 -u path).
+ *		Each client thread opens its own connection and sends a random mix
+ *		of commands, keeping up to depth of them in flight, so the server
+ *		sees pipelined input from every client at once.  When all are done
+ *		the commands per second and the latency percentiles are written as
+ *		CSV on stdout.
+ *
+ *		The mix is 40% ADDTAIL, 30% ASSIGNSU, 20% DELSU and 10% STATS, on
+ *		user ids below twice the list size.  Each command is followed by
+ *		the line MARK, which lab3 echoes as "# MARK" since it is not a
+ *		command, so the end of each reply can be found.  The latency of a
+ *		command is from the write that sent it to the read that brought its
+ *		MARK.
+ *
+ *		Usage: ./loadgen -u path [-c clients] [-d depth] [-n ops] [-s size]
+ *
+ *		-u: the socket lab3 -u listens on
+ *		-c: client connections, each on its own thread, by default 4
+ *		-d: commands in flight on each connection, by default 16
+ *		-n: commands sent by each client, by default 100000
+ *		-s: size limit given to CREATE, by default 100000
+ *
+ * Assumptions: The lists of the server are replaced with a CREATE before
+ *		the clients start.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// most client threads
+#define LOAD_MAX_CLIENTS 256
+
+// the reply to the MARK line sent after each command
+#define LOAD_MARK "# MARK\n"
+
+// one client thread and its connection
+typedef struct load_client_tag {
+    pthread_t thread;
+    int fd;
+    unsigned int seed;
+    long *latency;          // nanoseconds, one per command
+} load_client_t;
+
+static const char *load_path;
+static int load_depth = 16;
+static int load_ops = 100000;
+static int load_size = 100000;
+static pthread_barrier_t load_start;
+
+// Private functions used in this file only.
+void* LoadClient(void *arg);
+int LoadConnect(void);
+int LoadSend(int fd, const char *text, size_t length);
+int LoadCommand(char *text, unsigned int *seed);
+long LoadNow(void);
+unsigned int LoadRandom(unsigned int *seed);
+int LoadCompare(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    load_client_t client[LOAD_MAX_CLIENTS];
+    char text[64];
+    char reply[256];
+    int clients = 4;
+    long start, elapsed, total;
+    long *all;
+    int fd, i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-u") == 0) {
+            load_path = argv[i + 1];
+        } else if (strcmp(argv[i], "-c") == 0) {
+            clients = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-d") == 0) {
+            load_depth = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            load_ops = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            load_size = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+    if (i < argc || load_path == NULL || clients < 1 || clients > LOAD_MAX_CLIENTS
+            || load_depth < 1 || load_ops < 1 || load_size < 1) {
+        fprintf(stderr, "Usage: ./loadgen -u path [-c clients] [-d depth] "
+                "[-n ops] [-s size]\n");
+        exit(1);
+    }
+
+    // fresh lists, and wait for the server to close the connection
+    fd = LoadConnect();
+    snprintf(text, sizeof(text), "CREATE %d\nQUIT\n", load_size);
+    LoadSend(fd, text, strlen(text));
+    while (read(fd, reply, sizeof(reply)) > 0) {
+    }
+    close(fd);
+
+    pthread_barrier_init(&load_start, NULL, clients + 1);
+    for (i = 0; i < clients; i++) {
+        client[i].fd = LoadConnect();
+        client[i].seed = 1 + i;
+        client[i].latency = (long *) malloc(load_ops * sizeof(long));
+        pthread_create(&client[i].thread, NULL, LoadClient, &client[i]);
+    }
+    pthread_barrier_wait(&load_start);
+    start = LoadNow();
+    for (i = 0; i < clients; i++) {
+        pthread_join(client[i].thread, NULL);
+    }
+    elapsed = LoadNow() - start;
+
+    total = (long) clients * load_ops;
+    all = (long *) malloc(total * sizeof(long));
+    for (i = 0; i < clients; i++) {
+        memcpy(all + (long) i * load_ops, client[i].latency, load_ops * sizeof(long));
+        free(client[i].latency);
+        close(client[i].fd);
+    }
+    qsort(all, total, sizeof(long), LoadCompare);
+    printf("clients,depth,ops,seconds,ops_per_sec,p50_us,p90_us,p99_us,max_us\n");
+    printf("%d,%d,%ld,%.3f,%.0f,%.1f,%.1f,%.1f,%.1f\n", clients, load_depth,
+            total, elapsed / 1e9, total / (elapsed / 1e9),
+            all[total / 2] / 1e3, all[total * 9 / 10] / 1e3,
+            all[total * 99 / 100] / 1e3, all[total - 1] / 1e3);
+    free(all);
+    pthread_barrier_destroy(&load_start);
+    return 0;
+}
+
+/*** Private Functions ***/
+
+/* Client thread: sends load_ops commands, each followed by MARK, with up
+ * to load_depth of them waiting for replies, and times each one.
+ */
+void* LoadClient(void *arg) {
+    load_client_t *self = (load_client_t *) arg;
+    long *sent_at = (long *) malloc(load_depth * sizeof(long));
+    char *batch = (char *) malloc(load_depth * 64);
+    char reply[65536];
+    size_t length;
+    ssize_t got;
+    long now;
+    int sent = 0, done = 0;
+    int match = 0;      // bytes of LOAD_MARK matched on this line, or -1
+    int k;
+
+    pthread_barrier_wait(&load_start);
+    while (done < load_ops) {
+        // fill the window, all in one write
+        length = 0;
+        now = LoadNow();
+        while (sent < load_ops && sent - done < load_depth) {
+            length += LoadCommand(batch + length, &self->seed);
+            sent_at[sent % load_depth] = now;
+            sent++;
+        }
+        if (length > 0 && LoadSend(self->fd, batch, length) < 0) {
+            perror("loadgen: send");
+            exit(1);
+        }
+
+        got = read(self->fd, reply, sizeof(reply));
+        if (got <= 0) {
+            fprintf(stderr, "loadgen: server closed the connection\n");
+            exit(1);
+        }
+        now = LoadNow();
+        for (k = 0; k < got; k++) {
+            if (match >= 0 && reply[k] == LOAD_MARK[match]) {
+                match++;
+            }
+            else {
+                match = -1;
+            }
+            if (reply[k] == '\n') {
+                if (match == (int) strlen(LOAD_MARK)) {
+                    self->latency[done] = now - sent_at[done % load_depth];
+                    done++;
+                }
+                match = 0;
+            }
+        }
+    }
+    free(sent_at);
+    free(batch);
+    return NULL;
+}
+
+/* Connects to the server.  Exits if it cannot.
+ */
+int LoadConnect(void) {
+    struct sockaddr_un addr;
+    int fd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, load_path, sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror(load_path);
+        exit(1);
+    }
+    return fd;
+}
+
+/* Writes all of text.  Returns 0, or -1 on an error.
+ */
+int LoadSend(int fd, const char *text, size_t length) {
+    ssize_t done;
+
+    while (length > 0) {
+        done = send(fd, text, length, MSG_NOSIGNAL);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        text += done;
+        length -= done;
+    }
+    return 0;
+}
+
+/* Writes a random command and the MARK line after it into text, and
+ * returns their length.
+ */
+int LoadCommand(char *text, unsigned int *seed) {
+    int pick = LoadRandom(seed) % 10;
+    int id = LoadRandom(seed) % (2 * load_size);
+    int channel = 1 + LoadRandom(seed) % 10;
+
+    if (pick < 4) {
+        return sprintf(text, "ADDTAIL %d\nMARK\n", id);
+    }
+    if (pick < 7) {
+        return sprintf(text, "ASSIGNSU %d\nMARK\n", channel);
+    }
+    if (pick < 9) {
+        return sprintf(text, "DELSU %d\nMARK\n", id);
+    }
+    return sprintf(text, "STATS\nMARK\n");
+}
+
+/* Monotonic time in nanoseconds.
+ */
+long LoadNow(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* xorshift random numbers, one state per thread.
+ */
+unsigned int LoadRandom(unsigned int *seed) {
+    unsigned int x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+/* qsort comparison for latencies, smallest first.
+ */
+int LoadCompare(const void *a, const void *b) {
+    long time_a = *(const long *) a;
+    long time_b = *(const long *) b;
+
+    return (time_a > time_b) - (time_a < time_b);
+}
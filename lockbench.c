@@ -0,0 +1,199 @@
+/* lockbench.c
+ * MP3
+ *
+ * Purpose: Stress benchmark for LIST_LOCKED lists.  An assigned list and
+ *		a waiting queue are filled as lab3 would fill them.  Then, for each
+ *		reader count, that many reader threads look up random users in the
+ *		assigned list and read the size of their channel, each under the
+ *		read lock, while one writer thread moves users between the two
+ *		lists under list_lock_pair.  Each point runs for a fixed time and
+ *		the reads and writes per second are written as CSV on stdout, so
+ *		the scaling of read throughput with cores can be seen.
+ *
+ *		Usage: ./lockbench [-n users] [-t readers] [-s seconds]
+ *
+ *		-n: users in the assigned list, by default 100000, plus a tenth
+ *		    as many in the waiting queue
+ *		-t: largest reader count, by default twice the processors.  The
+ *		    counts tried double from 1 up to it.
+ *		-s: seconds for each reader count, by default 1
+ *
+ * Assumptions: The writer keeps both lists the same size: each write
+ *		assigns the head of the waiting queue and moves one random user
+ *		back to the waiting queue.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "datatypes.h"
+#include "list.h"
+#include "sas_support.h"
+
+// largest reader count
+#define BENCH_MAX_READERS 256
+
+// one reader or writer thread
+typedef struct bench_thread_tag {
+    pthread_t thread;
+    ListPtr assigned;
+    ListPtr waiting;
+    int users;
+    unsigned int seed;
+    unsigned long ops;
+} bench_thread_t;
+
+// set when the threads of a point should stop
+static int bench_stop;
+
+// Private functions used in this file only.
+void* BenchReader(void *arg);
+void* BenchWriter(void *arg);
+unsigned int BenchRandom(unsigned int *seed);
+
+int main(int argc, char *argv[])
+{
+    bench_thread_t reader[BENCH_MAX_READERS];
+    bench_thread_t writer;
+    ListPtr assigned, waiting;
+    int mode = LIST_POOL | LIST_INTRUSIVE | LIST_HASH | LIST_LOCKED;
+    int users = 100000, max_readers, seconds = 1;
+    unsigned long reads;
+    su_info_t *rec_ptr;
+    int readers, i;
+
+    max_readers = 2 * (int) sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            users = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-t") == 0) {
+            max_readers = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-s") == 0) {
+            seconds = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+    if (i < argc || users < 10 || max_readers < 1
+            || max_readers > BENCH_MAX_READERS || seconds < 1) {
+        fprintf(stderr, "Usage: ./lockbench [-n users] [-t readers] "
+                "[-s seconds]\n");
+        exit(1);
+    }
+
+    // even IDs are assigned and odd IDs wait, so a lookup hits half the time
+    assigned = list_construct_mode(sas_compare, sas_key, mode | LIST_SKIP, NULL);
+    sas_index_channels(assigned, SAS_INDEX_CHAINS);
+    waiting = list_construct_mode(sas_compare, sas_key, mode, assigned);
+    for (i = 0; i < users; i++) {
+        rec_ptr = list_elem_alloc(assigned);
+        rec_ptr->su_id = 2 * i;
+        rec_ptr->channel = 1 + i % SAS_MAX_CHANNEL;
+        list_insert_sorted(assigned, rec_ptr);
+    }
+    for (i = 0; i < users / 10; i++) {
+        sas_addtail(waiting, 2 * i + 1);
+    }
+
+    printf("readers,reads_per_sec,reads_per_sec_per_reader,writes_per_sec\n");
+    for (readers = 1; readers <= max_readers; readers *= 2) {
+        bench_stop = 0;
+        writer.assigned = assigned;
+        writer.waiting = waiting;
+        writer.users = users;
+        writer.seed = 1;
+        writer.ops = 0;
+        pthread_create(&writer.thread, NULL, BenchWriter, &writer);
+        for (i = 0; i < readers; i++) {
+            reader[i] = writer;
+            reader[i].seed = 2 + i;
+            pthread_create(&reader[i].thread, NULL, BenchReader, &reader[i]);
+        }
+        sleep(seconds);
+        __atomic_store_n(&bench_stop, 1, __ATOMIC_RELAXED);
+
+        reads = 0;
+        for (i = 0; i < readers; i++) {
+            pthread_join(reader[i].thread, NULL);
+            reads += reader[i].ops;
+        }
+        pthread_join(writer.thread, NULL);
+        printf("%d,%.0f,%.0f,%.0f\n", readers, (double) reads / seconds,
+                (double) reads / seconds / readers,
+                (double) writer.ops / seconds);
+        fflush(stdout);
+    }
+
+    list_destruct(waiting);
+    list_destruct(assigned);
+    return 0;
+}
+
+/*** Private Functions ***/
+
+/* Reader thread: finds a random user in the assigned list and reads the
+ * size of its channel, under the read lock, until told to stop.
+ */
+void* BenchReader(void *arg) {
+    bench_thread_t *self = (bench_thread_t *) arg;
+    su_info_t template_rec;
+    IteratorPtr match;
+    int channel;
+
+    memset(&template_rec, 0, sizeof(template_rec));
+    while (!__atomic_load_n(&bench_stop, __ATOMIC_RELAXED)) {
+        template_rec.su_id = BenchRandom(&self->seed) % (2 * self->users);
+        list_lock(self->assigned, LIST_READ);
+        match = list_elem_find(self->assigned, &template_rec);
+        if (match != NULL) {
+            channel = list_access(self->assigned, match)->channel;
+            (void) list_group_size(self->assigned, channel);
+        }
+        list_unlock(self->assigned);
+        self->ops++;
+    }
+    return NULL;
+}
+
+/* Writer thread: assigns the head of the waiting queue to a random channel
+ * and moves a random assigned user back to the waiting queue, with both
+ * lists locked, until told to stop.
+ */
+void* BenchWriter(void *arg) {
+    bench_thread_t *self = (bench_thread_t *) arg;
+    su_info_t template_rec;
+    IteratorPtr match;
+
+    memset(&template_rec, 0, sizeof(template_rec));
+    while (!__atomic_load_n(&bench_stop, __ATOMIC_RELAXED)) {
+        template_rec.su_id = BenchRandom(&self->seed) % (2 * self->users);
+        list_lock_pair(self->assigned, self->waiting, LIST_WRITE);
+        match = list_elem_find(self->assigned, &template_rec);
+        if (match != NULL && list_size(self->waiting) > 0) {
+            list_access(self->waiting, list_iter_front(self->waiting))->channel =
+                1 + BenchRandom(&self->seed) % SAS_MAX_CHANNEL;
+            list_transfer_sorted(self->assigned, self->waiting, NULL);
+            list_transfer(self->waiting, NULL, self->assigned, match);
+            self->ops++;
+        }
+        list_unlock_pair(self->assigned, self->waiting);
+    }
+    return NULL;
+}
+
+/* xorshift random numbers, one state per thread.
+ */
+unsigned int BenchRandom(unsigned int *seed) {
+    unsigned int x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
@@ -1,87 +1,97 @@
-#!/bin/sh
-# mp3test.sh
-#
-# A simple shell script for MP3 to generate data for performance analysis
-#
-# This script should run in the range from about 12 to 30 seconds.
-#
-# There are two options to execute this file: either make the file executable
-#    or run the file in a new shell.
-#
-# Option 1:  In a terminal type:
-#      chmod +x mp3test.sh
-#      ./mp3test.sh
-#
-# Option 2: run the program sh (this is a command shell) and tell sh to read
-#    the commands from the file mp3test.sh
-#     sh mp3test.sh
-#
-# There are four tests for:
-#    Insertion Sort, Recursive Selection Sort, Iterative Selection Sort,
-#    and Merge Sort. 
-#
-# Each sort is run with random, ascending, and decending lists.
-# 
-# "sizes" is used to hold the size for each trial
-#
-# TEST 1 Insertion sort
-echo "The date today is `date`"
-echo "insertion sort with random list"
-sizes="1000 4000 8000 12000 16000"
-for listsize in $sizes ; do
-   ./geninput $listsize 1 1 | ./lab3
-done
-echo "insertion sort with ascending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 2 1 | ./lab3
-done
-echo "insertion sort with descending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 3 1 | ./lab3
-done
-#
-# TEST 2 Recursive selection sort
-echo "recursive selection sort with random list"
-for listsize in $sizes ; do
-   ./geninput $listsize 1 2 | ./lab3
-done
-echo "recursive selection sort with ascending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 2 2 | ./lab3
-done
-echo "recursive selection sort with descending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 3 2 | ./lab3
-done
-#
-# TEST 3 Iterative selection sort
-echo "iterative selection sort with random list"
-for listsize in $sizes ; do
-   ./geninput $listsize 1 3 | ./lab3
-done
-echo "iterative selection sort with ascending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 2 3 | ./lab3
-done
-echo "iterative selection sort with descending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 3 3 | ./lab3
-done
-#
-# TEST 4 Merge sort
-echo "merge sort with random list"
-sizes="16000 100000 200000 300000 400000"
-for listsize in $sizes ; do
-   ./geninput $listsize 1 4 | ./lab3
-done
-echo "merge sort with ascending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 2 4 | ./lab3
-done
-echo "merge sort with descending list"
-for listsize in $sizes ; do
-   ./geninput $listsize 3 4 | ./lab3
-done
-#
-echo "end"
-
+#!/bin/sh
+# mp3test.sh
+#
+# A simple shell script for MP3 to generate data for performance analysis
+#
+# There are two options to execute this file: either make the file executable
+#    or run the file in a new shell.
+#
+# Option 1:  In a terminal type:
+#      chmod +x mp3test.sh
+#      ./mp3test.sh [results.csv]
+#
+# Option 2: run the program sh (this is a command shell) and tell sh to read
+#    the commands from the file mp3test.sh
+#     sh mp3test.sh [results.csv]
+#
+# The timings come from ./driver, which calls list_sort directly with warmup
+# runs and repetitions and writes the median and 95th percentile times of
+# each test as CSV (results.csv by default).  Every pattern is used:
+#    1 random, 2 ascending, 3 descending, 4 nearly sorted,
+#    5 duplicate heavy, 6 sawtooth
+#
+# TEST 1 The quadratic sorts: insertion sort and the recursive and iterative
+#    selection sorts, on short lists.
+# TEST 2 The other sorts on lists of up to a million users.  For lists of
+#    10 million users run SIZES=16000,1000000,10000000 sh mp3test.sh, which
+#    needs about 2 GB of memory and takes an hour or more.
+# TEST 3 Each sort once through lab3 with input from ./geninput, to check
+#    the SORT command end to end.
+# TEST 4 lab3 -n 1 against lab3 without shards on the same commands, which
+#    must print the same, with the default lists and with -w.
+#
+out=${1:-results.csv}
+SIZES=${SIZES:-"16000,100000,1000000"}
+make lab3 driver geninput > /dev/null || exit 1
+echo "The date today is `date`"
+#
+# TEST 1 Quadratic sorts
+echo "insertion and selection sorts, results in $out"
+./driver -t 1,2,3 -n 1000,4000,8000,12000,16000 > $out || exit 1
+#
+# TEST 2 Merge, radix, parallel and key array sorts
+echo "merge, radix, parallel and key array sorts, sizes $SIZES"
+./driver -t 4,5,6,7,8,9,10 -n $SIZES | tail -n +2 >> $out || exit 1
+#
+# TEST 3 The SORT command in lab3: size, CPU ms, sort type, wall clock ms
+echo "lab3 SORT on 16000 random users"
+for sort_type in 1 2 3 4 5 6 7 8 9 10 ; do
+   ./geninput 16000 1 $sort_type | ./lab3 | grep "^16000	"
+done
+#
+# TEST 4 One shard prints what the lists without shards print
+echo "lab3 -n 1 against lab3"
+cat > mp3test.in << EOF
+CREATE 5
+ADDTAIL 3
+ADDTAIL 4
+ASSIGNSU 1
+CREATE 0
+ADDTAIL 7
+ASSIGNSU 1
+ASSIGNBATCH 2 1
+STATS
+CREATE 4
+PRINTWAITING
+ADDTAIL 9
+ADDTAIL 2
+ADDTAIL 6
+ADDTAIL 8
+ADDTAIL 5
+ADDTAIL 1
+ASSIGNBATCH 3 2
+ASSIGNSU 3
+ASSIGNBATCH 4 4
+CHANGECH 2 4
+LISTCH 4
+DELSU 6
+CLEARCH 3
+ASSIGNBATCH 9 1
+PRINTASSIGNED
+PRINTWAITING
+STATS
+QUIT
+EOF
+for opt in "" "-w" ; do
+   ./lab3 $opt < mp3test.in > mp3test.out1
+   ./lab3 -n 1 $opt < mp3test.in > mp3test.out2
+   if cmp -s mp3test.out1 mp3test.out2 ; then
+      echo "same output with options '$opt'"
+   else
+      echo "different output with options '$opt':"
+      diff mp3test.out1 mp3test.out2
+   fi
+done
+rm -f mp3test.in mp3test.out1 mp3test.out2
+#
+echo "end"
@@ -0,0 +1,266 @@
+/* output.c 
+ * MP3
+ *
+ * Purpose: This file renders the bulk output of the SAS application, such
+ *		as a print of every record in a list.  Text is formatted by hand into
+ *		a buffer of OUTPUT_BLOCK bytes, which is written with a few calls to
+ *		write instead of several printf calls for each record.
+ *		output_printf takes the place of printf for the rest of the output,
+ *		so that all of it can be captured into a buffer of the caller, as
+ *		the server mode does for each connection.
+ *
+ * Assumptions: output_int prints like "%d" and output_float like "%g", so
+ *		the text is exactly what printf would give.  Standard output is 
+ *		flushed before the buffer is written, so text printed with printf 
+ *		earlier comes first.
+ *		The capture and the float cache are kept for each thread, so worker
+ *		threads may format into buffers of their own at once.  Only one
+ *		thread prints to stdout.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "output.h"
+
+// floats formatted with snprintf are kept in a small direct-mapped cache,
+// since a field such as the band takes only a few different values
+#define OUTPUT_FLOAT_CACHE 64
+
+// Private functions used in this file only.
+void OutputWrite(const char *text, size_t length);
+void OutputRoom(size_t length);
+void OutputBytes(const char *text, size_t length);
+void OutputAppend(const char *text, size_t length);
+
+typedef struct {
+    unsigned int bits;  // the float the text is for
+    int length;         // 0 for an empty entry
+    char text[16];
+} output_float_t;
+
+static char output_buffer[OUTPUT_BLOCK];
+static size_t output_used = 0;
+static __thread output_float_t output_cache[OUTPUT_FLOAT_CACHE];
+
+// the buffer output goes to while it is captured, or NULL for stdout
+static __thread output_buf_t *output_sink = NULL;
+
+// "00" to "99", for printing two digits at a time
+static const char output_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Adds a string to the output buffer.
+ */
+void output_text(const char *text)
+{
+    OutputBytes(text, strlen(text));
+}
+
+/* Adds the text held in a capture buffer, as if it were printed now.
+ */
+void output_buf(const output_buf_t *buf_ptr)
+{
+    if (buf_ptr->used > 0) { // text is NULL while nothing was captured
+        OutputBytes(buf_ptr->text, buf_ptr->used);
+    }
+}
+
+/* Adds an integer to the output buffer, as printf("%d") would print it.
+ */
+void output_int(int value)
+{
+    char digits[12];
+    char *p = digits + sizeof(digits);
+    unsigned int magnitude = (value < 0) ? 0u - (unsigned int) value : (unsigned int) value;
+    size_t length;
+
+    // two digits at a time from the right
+    while (magnitude >= 100) {
+        unsigned int pair = (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--p = output_pairs[pair + 1];
+        *--p = output_pairs[pair];
+    }
+    if (magnitude >= 10) {
+        *--p = output_pairs[magnitude * 2 + 1];
+        *--p = output_pairs[magnitude * 2];
+    }
+    else {
+        *--p = (char) ('0' + magnitude);
+    }
+    if (value < 0) {
+        *--p = '-';
+    }
+
+    length = digits + sizeof(digits) - p;
+    OutputAppend(p, length);
+}
+
+/* Adds a float to the output buffer, as printf("%g") would print it.
+ *
+ * A whole number below one million prints as the integer, which is what
+ * %g gives for it.  Other values are formatted with snprintf and cached by
+ * their bit pattern.
+ */
+void output_float(float value)
+{
+    output_float_t *entry;
+    unsigned int bits;
+
+    if (value == floorf(value) && fabsf(value) < 1e6f && !(value == 0 && signbit(value))) {
+        output_int((int) value);
+        return;
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    entry = &output_cache[(bits * 2654435761u) >> 26];
+    if (entry->length == 0 || entry->bits != bits) {
+        entry->bits = bits;
+        entry->length = snprintf(entry->text, sizeof(entry->text), "%g", value);
+    }
+    OutputAppend(entry->text, entry->length);
+}
+
+/* Prints like printf.  The text goes straight to stdout, as printf would
+ * send it, unless output is captured.
+ */
+void output_printf(const char *format, ...)
+{
+    char text[256];
+    char *long_text;
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    if (output_sink == NULL) {
+        vprintf(format, args);
+        va_end(args);
+        return;
+    }
+    length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    if (length < (int) sizeof(text)) {
+        OutputAppend(text, length);
+        return;
+    }
+    long_text = (char *) malloc(length + 1);
+    va_start(args, format);
+    vsnprintf(long_text, length + 1, format, args);
+    va_end(args);
+    OutputAppend(long_text, length);
+    free(long_text);
+}
+
+/* Writes out the output buffer, after anything waiting in stdout.  Captured
+ * output is already in place, so nothing is done for it.
+ */
+void output_flush(void)
+{
+    if (output_sink != NULL) {
+        return;
+    }
+    fflush(stdout);
+    OutputWrite(output_buffer, output_used);
+    output_used = 0;
+}
+
+/* Sends all output of this thread to the end of *buf_ptr, until
+ * output_capture(NULL) sends it to stdout again.  Output buffered for
+ * stdout stays in the buffer until the next output_flush.
+ *
+ * Returns the buffer output went to before, or NULL, so a capture can be
+ * nested inside another one and then put back.
+ */
+output_buf_t *output_capture(output_buf_t *buf_ptr)
+{
+    output_buf_t *previous = output_sink;
+
+    output_sink = buf_ptr;
+    return previous;
+}
+
+/*** Private Functions ***/
+
+/* Writes text to standard output past the stdio buffer.  If stdout has no
+ * file descriptor, the text goes through fwrite instead.
+ */
+void OutputWrite(const char *text, size_t length) {
+    int fd = fileno(stdout);
+    ssize_t done;
+
+    if (fd < 0) {
+        fwrite(text, 1, length, stdout);
+        return;
+    }
+    while (length > 0) {
+        done = write(fd, text, length);
+        if (done < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        text += done;
+        length -= done;
+    }
+}
+
+/* Adds text of any length to the capture buffer or the output buffer.
+ * Text longer than the whole output buffer is written straight out.
+ */
+void OutputBytes(const char *text, size_t length) {
+    if (output_sink != NULL) {
+        OutputAppend(text, length);
+        return;
+    }
+    if (length > OUTPUT_BLOCK - output_used) {
+        output_flush();
+        if (length > OUTPUT_BLOCK) {
+            OutputWrite(text, length);
+            return;
+        }
+    }
+    memcpy(output_buffer + output_used, text, length);
+    output_used += length;
+}
+
+/* Adds text that is not NUL terminated to the capture buffer, or else to
+ * the output buffer.
+ */
+void OutputAppend(const char *text, size_t length) {
+    output_buf_t *buf = output_sink;
+
+    if (buf == NULL) {
+        OutputRoom(length);
+        memcpy(output_buffer + output_used, text, length);
+        output_used += length;
+        return;
+    }
+    if (length > buf->size - buf->used) {
+        buf->size = (buf->size < 256) ? 256 : buf->size;
+        while (length > buf->size - buf->used) {
+            buf->size *= 2;
+        }
+        buf->text = (char *) realloc(buf->text, buf->size);
+    }
+    memcpy(buf->text + buf->used, text, length);
+    buf->used += length;
+}
+
+/* Makes room for length more bytes in the output buffer.
+ */
+void OutputRoom(size_t length) {
+    if (length > OUTPUT_BLOCK - output_used) {
+        output_flush();
+    }
+}
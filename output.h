@@ -0,0 +1,32 @@
+/* output.h 
+ * MP3
+ *
+ * Purpose: Public functions for rendering text, integers and floats into
+ * a large output buffer that is written to standard output in blocks, or
+ * into a buffer of the caller while output is captured.
+ *
+ * Assumptions: Text given to these functions comes out after anything
+ * already printed with printf, once output_flush is called.  A capture is
+ * for the calling thread only, and only one thread prints to stdout.
+ *
+ * Bugs:
+ */
+
+// size of the output buffer, written out whenever it fills
+#define OUTPUT_BLOCK 1048576
+
+// a buffer that output_capture appends to, grown with realloc; start it
+// with all fields 0 and free text when done
+typedef struct output_buf_tag {
+    char *text;
+    size_t used;
+    size_t size;
+} output_buf_t;
+
+void output_text(const char *text);
+void output_int(int value);
+void output_float(float value);
+void output_printf(const char *format, ...);
+void output_flush(void);
+void output_buf(const output_buf_t *buf_ptr);
+output_buf_t *output_capture(output_buf_t *buf_ptr);
@@ -0,0 +1,101 @@
+/* pattern.c 
+ * MP3
+ *
+ * Purpose: This file generates the keys (user ids) of the lists that the
+ *		sorts are benchmarked on, for both geninput and driver.
+ *
+ *		PATTERN_RANDOM      keys drawn uniformly from 0 to 2^31 - 1
+ *		PATTERN_ASCENDING   0, 1, 2, ... already sorted
+ *		PATTERN_DESCENDING  size, size - 1, ... 1 in reverse order
+ *		PATTERN_NEARLY      ascending, with one key in a hundred swapped with
+ *		                    a key up to 8 places further on
+ *		PATTERN_DUPLICATES  keys drawn uniformly from only 16 values
+ *		PATTERN_SAWTOOTH    16 ascending runs of equal length, one after the
+ *		                    other, each starting again from 0
+ *
+ * Assumptions: Keys are random from a seeded xorshift generator, not rand(),
+ *		so the lists are the same on every system.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "pattern.h"
+
+// Private functions used in this file only.
+unsigned int PatternRandom(unsigned int *seed);
+
+static const char *pattern_names[] = { "", "random", "ascending", 
+    "descending", "nearly", "duplicates", "sawtooth" };
+
+/* Fills keys[0 .. size - 1] with the keys of a list in the given pattern.
+ *
+ * seed: any value but 0 picks the random keys; 0 is taken as 1.
+ */
+void pattern_fill(int *keys, int size, int pattern, unsigned int seed)
+{
+    int i, j, other, swap;
+    int tooth = size / 16 + 1;
+
+    assert(keys != NULL || size == 0);
+    if (seed == 0) {
+        seed = 1;
+    }
+    for (i = 0; i < size; i++) {
+        switch (pattern) {
+        case PATTERN_RANDOM:
+            keys[i] = (int) (PatternRandom(&seed) >> 1);
+            break;
+        case PATTERN_DESCENDING:
+            keys[i] = size - i;
+            break;
+        case PATTERN_DUPLICATES:
+            keys[i] = (int) (PatternRandom(&seed) % 16);
+            break;
+        case PATTERN_SAWTOOTH:
+            keys[i] = i % tooth;
+            break;
+        default:    // ascending, and the start of nearly sorted
+            keys[i] = i;
+        }
+    }
+    if (pattern == PATTERN_NEARLY) {
+        for (i = 0; i < (size + 99) / 100; i++) {
+            j = (int) (PatternRandom(&seed) % size);
+            other = j + 1 + (int) (PatternRandom(&seed) % 8);
+            if (other < size) {
+                swap = keys[j];
+                keys[j] = keys[other];
+                keys[other] = swap;
+            }
+        }
+    }
+}
+
+/* Returns the name of a pattern for reports, or NULL if there is no such
+ * pattern.
+ */
+const char *pattern_name(int pattern)
+{
+    if (pattern < 1 || pattern > PATTERN_COUNT) {
+        return NULL;
+    }
+    return pattern_names[pattern];
+}
+
+/*** Private Functions ***/
+
+/* Returns the next number of a xorshift generator, which must not start
+ * at 0.
+ */
+unsigned int PatternRandom(unsigned int *seed) {
+    unsigned int x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
@@ -0,0 +1,23 @@
+/* pattern.h 
+ * MP3
+ *
+ * Purpose: Public functions for the key sequences used to benchmark the
+ * sorts: random, ascending, descending, nearly sorted, duplicate heavy 
+ * and sawtooth.
+ *
+ * Assumptions: The same pattern, size and seed always give the same keys.
+ *
+ * Bugs:
+ */
+
+// the patterns, numbered as on the geninput and driver command lines
+#define PATTERN_RANDOM     1
+#define PATTERN_ASCENDING  2
+#define PATTERN_DESCENDING 3
+#define PATTERN_NEARLY     4
+#define PATTERN_DUPLICATES 5
+#define PATTERN_SAWTOOTH   6
+#define PATTERN_COUNT      6
+
+void pattern_fill(int *keys, int size, int pattern, unsigned int seed);
+const char *pattern_name(int pattern);
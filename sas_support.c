@@ -19,15 +19,46 @@
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "datatypes.h"
 #include "list.h"
 #include "sas_support.h"
+#include "input.h"
+#include "output.h"
  
+// header of a snapshot file written by sas_save.  The assigned list and
+// then the waiting queue follow as packed arrays of su_info_t, in list 
+// order and in the byte order of the machine that wrote them
+typedef struct {
+    char magic[8];              // SAS_SNAP_MAGIC
+    unsigned int version;       // SAS_SNAP_VERSION
+    unsigned int record_size;   // sizeof(su_info_t) of the writer
+    int sorted_size;            // size limit of the assigned list
+    int assigned_count;
+    int waiting_count;
+    unsigned int sorted_flags;  // SAS_SNAP_ASSIGNED_SORTED, SAS_SNAP_WAITING_SORTED
+    unsigned int checksum;      // sas_checksum of the records
+    unsigned int reserved;      // 0
+} sas_snap_header_t;
+
+#define SAS_SNAP_MAGIC "SASSNAP"
+#define SAS_SNAP_VERSION 1
+#define SAS_SNAP_ASSIGNED_SORTED 0x1
+#define SAS_SNAP_WAITING_SORTED  0x2
+
 // Private functions used in this file only.  Do not include prototype
 // in the header file
-void sas_record_fill(su_info_t *rec);   // collect input from user 
-void sas_record_print(su_info_t *rec);  // print one record 
+void sas_record_print(const su_info_t *rec);  // print one record 
+unsigned int sas_checksum(unsigned int sum, const su_info_t *rec, int count);
+int sas_save_list(FILE *fp, ListPtr list_ptr, unsigned int *sum);
+const char *sas_load_check(const sas_snap_header_t *head, size_t bytes);
+IteratorPtr *sas_column_match(ListPtr list_ptr, int channel, int *count);
+void sas_drain(ListPtr list_ptr);
 
 /* sas_compare is required by the list ADT for sorted lists. 
  *
@@ -53,6 +84,23 @@ int sas_compare(const su_info_t *record_a, const su_info_t *record_b)
         return 0;
 }
 
+/* sas_key gives the list ADT an integer key that orders records exactly as
+ * sas_compare does, for the radix sort.
+ */
+int sas_key(const su_info_t *record)
+{
+    assert(record != NULL);
+    return record->su_id;
+}
+
+/* sas_channel gives the list ADT the group of a record for the per-channel
+ * index of the assigned list.
+ */
+int sas_channel(const su_info_t *record)
+{
+    assert(record != NULL);
+    return record->channel;
+}
 
 /* print the secondary user record list 
  *
@@ -68,23 +116,59 @@ void sas_print(ListPtr list_ptr, char *type_of_list)
     assert(strcmp(type_of_list, "Assigned List")==0 
             || strcmp(type_of_list, "Waiting Queue")==0);
     IteratorPtr index;
-    int num_in_list = list_size(list_ptr);
+    int num_in_list;
     int counter = 0;
 
+    sas_drain(list_ptr);
+    list_lock(list_ptr, LIST_READ);
+    num_in_list = list_size(list_ptr);
+
+    // the whole list is rendered into the output buffer, see output.c
     if (num_in_list == 0) {
-        printf("%s empty\n", type_of_list);
+        output_text(type_of_list);
+        output_text(" empty\n");
     } else {
-        printf("%s has %d records\n", type_of_list, num_in_list);
+        output_text(type_of_list);
+        output_text(" has ");
+        output_int(num_in_list);
+        output_text(" records\n");
         index = list_iter_front(list_ptr);
         while (index != NULL)
         {
-            printf("%d: ", ++counter);
+            output_int(++counter);
+            output_text(": ");
             sas_record_print(list_access(list_ptr, index));
             index = list_iter_next(index);
         }
         assert(num_in_list == counter);
     }
-    printf("\n");
+    list_unlock(list_ptr);
+    output_text("\n");
+    output_flush();
+}
+
+/* Prints records gathered into an array, in the format of sas_print, for
+ * a list that is split over shards.
+ */
+void sas_print_array(const su_info_t *rec, int count, const char *type_of_list)
+{
+    int i;
+
+    output_text(type_of_list);
+    if (count == 0) {
+        output_text(" empty\n");
+    } else {
+        output_text(" has ");
+        output_int(count);
+        output_text(" records\n");
+        for (i = 0; i < count; i++) {
+            output_int(i + 1);
+            output_text(": ");
+            sas_record_print(&rec[i]);
+        }
+    }
+    output_text("\n");
+    output_flush();
 }
 
 /* This creates a list for storing secondary user records.  Based on
@@ -99,20 +183,49 @@ void sas_print(ListPtr list_ptr, char *type_of_list)
  * null, then the old list should be destructed and a pointer to the
  * new list is returned.  This interface is similar to how the 
  * recalloc() function works.
+ *
+ * Records move between the assigned list and the waiting queue, so both
+ * must share one allocator.  peer_ptr is the other list (or NULL), and
+ * mode is passed to list_construct_mode.
  */
-ListPtr sas_create(ListPtr list_ptr, const char *type)
+ListPtr sas_create(ListPtr list_ptr, const char *type, ListPtr peer_ptr,
+        int mode)
 {
     // function to describe how the data will be compared for sorting
     int (*comp_function) (const su_info_t *, const su_info_t *);
     comp_function = sas_compare;
 
     if (list_ptr != NULL) {
-         printf("Replacing existing %s\n", type);
+         output_printf("Replacing existing %s\n", type);
 		  list_destruct(list_ptr);
     } else {
-         printf("New %s\n", type);
+         output_printf("New %s\n", type);
     }
-    return list_construct(comp_function);
+    return list_construct_mode(comp_function, sas_key, mode, peer_ptr);
+}
+
+/* Adds a per-channel index to a newly created assigned list, so the users
+ * on one channel can be reached without a scan of the whole list.
+ *
+ * how: SAS_INDEX_CHAINS chains the users of each channel together, so
+ *      LISTCH, CLEARCH and CHANGECH cost O(users on the channels involved).
+ *      SAS_INDEX_COLUMN keeps the channels in one array of bytes that is
+ *      scanned with SIMD compares, so the scan loads no records and only 
+ *      the matching users are visited.  CHANGECH rewrites the array with
+ *      vector blends.
+ *      SAS_INDEX_NONE adds nothing.
+ */
+void sas_index_channels(ListPtr list_ptr, int how)
+{
+	if (list_ptr == NULL) {
+		return;
+	}
+	if (how == SAS_INDEX_CHAINS) {
+		list_set_groups(list_ptr, sas_channel, SAS_MAX_CHANNEL + 1);
+	}
+	else if (how == SAS_INDEX_COLUMN) {
+		list_set_column(list_ptr, sas_channel, SAS_MAX_CHANNEL + 1);
+	}
 }
 
 /* This function adds the secondary record to one of the lists.  
@@ -132,73 +245,78 @@ ListPtr sas_create(ListPtr list_ptr, const char *type)
  *      the waiting queue
  */
 void sas_add(ListPtr assn_ptr, int size, ListPtr wait_ptr)
+{
+    su_info_t new_rec;   // filled first so the input is always consumed
+    memset(&new_rec, 0, sizeof(su_info_t));
+    sas_record_fill(&new_rec);
+    sas_add_rec(assn_ptr, size, wait_ptr, &new_rec);
+}
+
+/* Adds a secondary user record that is already filled in, as sas_add does
+ * after collecting it from the user.  The record is copied.
+ */
+void sas_add_rec(ListPtr assn_ptr, int size, ListPtr wait_ptr, const su_info_t *rec)
 {
     int add_action = -2;
-    su_info_t *rec_ptr;
-    rec_ptr = (su_info_t *) calloc(1, sizeof(su_info_t));
-    sas_record_fill(rec_ptr);
+    su_info_t new_rec = *rec;
+    su_info_t *rec_ptr = NULL;
 
 	// don't let it add something to null list
 	 if ((assn_ptr == NULL) || (wait_ptr == NULL)) {
-		 free(rec_ptr);
-		 rec_ptr = NULL;
 		 return;
 	 }
+	 list_lock_pair(assn_ptr, wait_ptr, LIST_WRITE);
+	 list_drain(wait_ptr); // the user may be waiting in the inbox
  
     // figure out how to add and set add_action
-	 IteratorPtr match = list_elem_find(assn_ptr, rec_ptr);
+	 IteratorPtr match = list_elem_find(assn_ptr, &new_rec);
 	 if (match != NULL) { // found in assigned list
-		 if (rec_ptr->channel == list_access(assn_ptr, match)->channel) { // same channel
-			 // remove old entry, put in new for update
-			 free(list_remove(assn_ptr, match));
+		 rec_ptr = list_access(assn_ptr, match);
+		 if (new_rec.channel == rec_ptr->channel) { // same channel
+			 // take the old entry out and put the update back in sorted
+			 // order, after any others with the same ID
+			 *rec_ptr = new_rec;
+			 list_transfer_sorted(assn_ptr, assn_ptr, match);
 			 match = NULL;
-			 list_insert_sorted(assn_ptr, rec_ptr);
 			 add_action = 0;
 		 }
 		 else { // different channel
-			 // remove old entry, put new into waiting
-			 free(list_remove(assn_ptr, match));
+			 // reuse the old record and node for the new entry in waiting
+			 list_transfer(wait_ptr, NULL, assn_ptr, match);
 			 match = NULL;
-			 list_insert(wait_ptr, rec_ptr, NULL);
+			 *rec_ptr = new_rec;
 			 add_action = 1;
 		 }
 	 }
 	 else {
-		 match = list_elem_find(wait_ptr, rec_ptr); 
+		 match = list_elem_find(wait_ptr, &new_rec); 
 		 if (match != NULL) { // found in waiting list
 			 // update all info
 			 su_info_t *foundData = list_access(wait_ptr, match);
-			 assert(rec_ptr->su_id == foundData->su_id);
-			 foundData->ip_address = rec_ptr->ip_address;
-			 foundData->access_point = rec_ptr->access_point;
-			 foundData->authenticated = rec_ptr->authenticated;
-			 foundData->privacy = rec_ptr->privacy;
-			 foundData->band = rec_ptr->band;
-			 foundData->channel = rec_ptr->channel;
-			 foundData->data_rate = rec_ptr->data_rate;
-			 foundData->time_received = rec_ptr->time_received;
-			 // free(rec_ptr);
-			 // rec_ptr = NULL;
+			 assert(new_rec.su_id == foundData->su_id);
+			 *foundData = new_rec;
 			 add_action = 2;
 		 }
 		 else { // completely new entry		 	
+			 rec_ptr = list_elem_alloc(wait_ptr);
+			 *rec_ptr = new_rec;
 			 list_insert(wait_ptr, rec_ptr, NULL);
 			 add_action = 3;
 		 }
 	 }
 
     if (add_action == 3) {
-        printf("Inserted new waiting SU: %d\n", rec_ptr->su_id);
+        output_printf("Inserted new waiting SU: %d\n", new_rec.su_id);
     } else if (add_action == 0) {
-        printf("Updated assigned SU: %d\n", rec_ptr->su_id);
+        output_printf("Updated assigned SU: %d\n", new_rec.su_id);
     } else if (add_action == 1) {
-        printf("Moved assigned SU to waiting: %d\n", rec_ptr->su_id);
+        output_printf("Moved assigned SU to waiting: %d\n", new_rec.su_id);
     } else if (add_action == 2) {
-        printf("Updated waiting SU: %d\n", rec_ptr->su_id);
-		  free(rec_ptr);
+        output_printf("Updated waiting SU: %d\n", new_rec.su_id);
     } else {
-        printf("Error with return value!\n");
+        output_printf("Error with return value!\n");
     }
+	 list_unlock_pair(assn_ptr, wait_ptr);
 	 match = NULL;
     rec_ptr = NULL;
 }
@@ -213,14 +331,35 @@ void sas_lookup(ListPtr list_ptr, int channel_no)
 		return;
 	}
     su_info_t *rec_ptr = NULL;
-    int i, num_in_list = list_size(list_ptr);  
+    int i, num_in_list;
 	 IteratorPtr rover = NULL;
+	 IteratorPtr *match = NULL;
+	 int match_count = 0;
 
+    // the column is built again on a scan, which changes the list
+    list_lock(list_ptr, list_column_groups(list_ptr) > 0 ? LIST_WRITE : LIST_READ);
+    num_in_list = list_size(list_ptr);
     if (num_in_list == 0) {
-        printf("List is empty: no users on ch %d\n", channel_no);
+        output_printf("List is empty: no users on ch %d\n", channel_no);
     } else {
-        printf("Assignment list has %d records.  Looking for SUs on ch %d\n", 
+        output_printf("Assignment list has %d records.  Looking for SUs on ch %d\n", 
                 num_in_list, channel_no);
+        if (list_group_count(list_ptr) > channel_no) {
+            // the channel index visits only the users on the channel
+            rover = list_group_front(list_ptr, channel_no);
+            while (rover != NULL) {
+                sas_record_print(list_access(list_ptr, rover));
+                rover = list_group_next(list_ptr, rover);
+            }
+            num_in_list = 0; // skip the scan below
+        }
+        else if ((match = sas_column_match(list_ptr, channel_no, &match_count)) != NULL) {
+            // the channel column gives the users on the channel in order
+            for (i = 0; i < match_count; i++) {
+                sas_record_print(list_access(list_ptr, match[i]));
+            }
+            num_in_list = 0; // skip the scan below
+        }
         // print record of each user on channel
         rover = list_iter_front(list_ptr);
         for (i = 0; i < num_in_list; i++) {
@@ -230,16 +369,38 @@ void sas_lookup(ListPtr list_ptr, int channel_no)
 				}
 				rover = list_iter_next(rover);
         }
+        output_flush();
     }
+    list_unlock(list_ptr);
 	 rover = NULL;
     rec_ptr = NULL;
 }
 
+/* Prints the users on a channel gathered into an array, in the format of
+ * sas_lookup.  num_in_list is the size of the whole assigned list.
+ */
+void sas_lookup_array(const su_info_t *rec, int count, int num_in_list, int channel_no)
+{
+    int i;
+
+    if (num_in_list == 0) {
+        output_printf("List is empty: no users on ch %d\n", channel_no);
+        return;
+    }
+    output_printf("Assignment list has %d records.  Looking for SUs on ch %d\n", 
+            num_in_list, channel_no);
+    for (i = 0; i < count; i++) {
+        sas_record_print(&rec[i]);
+    }
+    output_flush();
+}
+
 /* This function removes the record from either the sorted assigned list 
  * or the waiting queue.  There can only be one match.
  */
 void sas_remove(ListPtr assn_list, ListPtr wait_q, int su_id)
 {
+    su_info_t template_rec;
     su_info_t *rec_ptr = NULL;
 	 IteratorPtr match = NULL;
     int assigned_or_waiting = -1;
@@ -252,41 +413,38 @@ void sas_remove(ListPtr assn_list, ListPtr wait_q, int su_id)
 	 }
 
 	 // create a template su_info_t struct to look for
-    rec_ptr = (su_info_t*) malloc(sizeof(su_info_t));
-	 rec_ptr->su_id = su_id;
+	 template_rec.su_id = su_id;
+	 list_lock_pair(assn_list, wait_q, LIST_WRITE);
+	 list_drain(wait_q); // the user may be waiting in the inbox
 
-	 match = list_elem_find(assn_list, rec_ptr);
+	 match = list_elem_find(assn_list, &template_rec);
 	 if (match != NULL) { // found in assigned list
-		 free(rec_ptr); // so template entry doesn't result in mem leak
 		 rec_ptr = list_remove(assn_list, match);
 		 assigned_or_waiting = 0;
 	 }
 	 else {
-		 match = list_elem_find(wait_q, rec_ptr);
+		 match = list_elem_find(wait_q, &template_rec);
 		 if (match != NULL) { // found in wait list
-			 free(rec_ptr); // so template entry doesn't result in mem leak
 			 rec_ptr = list_remove(wait_q, match);
 			 assigned_or_waiting = 1;
 		 }
-		 else { // found nowhere
-			 free(rec_ptr);
-			 rec_ptr = NULL;
-		 }
 	 }
 	 match = NULL;
 
     if (rec_ptr == NULL) {
-        printf("Did not remove: %d\n", su_id);
+        output_printf("Did not remove: %d\n", su_id);
     } else if (assigned_or_waiting == 0) {
         assert(rec_ptr->su_id == su_id);
-        printf("Removed: %d from assigned list\n", su_id);
+        output_printf("Removed: %d from assigned list\n", su_id);
         sas_record_print(rec_ptr);
     } else if (assigned_or_waiting == 1) {
         assert(rec_ptr->su_id == su_id);
-        printf("Removed: %d from waiting queue\n", su_id);
+        output_printf("Removed: %d from waiting queue\n", su_id);
         sas_record_print(rec_ptr);
     }
-	 free(rec_ptr);
+    output_flush();
+	 list_elem_free(wait_q, rec_ptr);
+	 list_unlock_pair(assn_list, wait_q);
     rec_ptr = NULL;
 }
 
@@ -302,23 +460,44 @@ void sas_move(ListPtr assn_list, int channel, ListPtr wait_q)
 	 int i = 0, listTop = 0;
 	 IteratorPtr rover = NULL;
 	 IteratorPtr previous = NULL;
-	 su_info_t *removedData = NULL;
+	 IteratorPtr *match = NULL;
 
 	 // make sure list exists
 	 if ((assn_list == NULL) || (wait_q == NULL)) {
 		  return;
 	 }
 
-	 rover = list_iter_front(assn_list);
-	 listTop = list_size(assn_list);
+	 list_lock_pair(assn_list, wait_q, LIST_WRITE);
+	 list_drain(wait_q); // earlier ADDTAILs stay ahead of the moved users
+	 if (list_group_count(assn_list) > channel) {
+		 // the channel index is in list order, so IDs still increase
+		 rover = list_group_front(assn_list, channel);
+		 while (rover != NULL) {
+			 previous = rover;
+			 rover = list_group_next(assn_list, rover);
+			 list_transfer(wait_q, NULL, assn_list, previous);
+			 count_removed++;
+		 }
+	 }
+	 else if ((match = sas_column_match(assn_list, channel, &listTop)) != NULL) {
+		 // removing a user leaves the other matches valid
+		 for (i = 0; i < listTop; i++) {
+			 list_transfer(wait_q, NULL, assn_list, match[i]);
+		 }
+		 count_removed = listTop;
+		 listTop = 0; // skip the scan below
+	 }
+	 else {
+		 listTop = list_size(assn_list);
+		 rover = list_iter_front(assn_list);
+	 }
 	 // look through assigned list for matching channels
 	 for (i = 0; i < listTop; i++) {
 		 if (list_access(assn_list,rover)->channel == channel) {
 		 	 // if match, remove from assigned list and add to wait list
 			 previous = rover;
 			 rover = list_iter_next(rover);
-			 removedData = list_remove(assn_list, previous);
-			 list_insert(wait_q, removedData, NULL);
+			 list_transfer(wait_q, NULL, assn_list, previous);
 			 count_removed++;
 		 }
 		 else {
@@ -327,14 +506,14 @@ void sas_move(ListPtr assn_list, int channel, ListPtr wait_q)
 	 }
 
     if (count_removed == 0) {
-        printf("Did not find any users on channel %d\n", channel);
+        output_printf("Did not find any users on channel %d\n", channel);
     } else {
-        printf("Removed %d from channel %d\n", count_removed, channel);
+        output_printf("Removed %d from channel %d\n", count_removed, channel);
     }
+	 list_unlock_pair(assn_list, wait_q);
 
 	 rover = NULL;
 	 previous = NULL;
-	 removedData = NULL;
 }
 
 /* Change the channel number of any secondary user in the assigned
@@ -348,11 +527,34 @@ void sas_change(ListPtr list_ptr, int old_channel, int new_channel)
 	}
 
     int count_moved = 0;
-	 int i = 0;
+	 int i = 0, listTop = 0;
 	 IteratorPtr rover = NULL;
+	 IteratorPtr *match = NULL;
 
-	 rover = list_iter_front(list_ptr);
-	 for (i = 0; i < list_size(list_ptr); i++) {
+	 list_lock(list_ptr, LIST_WRITE);
+	 if (list_group_count(list_ptr) > old_channel && list_group_count(list_ptr) > new_channel) {
+		 // re-tag the users of the old channel, then move the whole bucket
+		 rover = list_group_front(list_ptr, old_channel);
+		 while (rover != NULL) {
+			 list_access(list_ptr, rover)->channel = new_channel;
+			 count_moved++;
+			 rover = list_group_next(list_ptr, rover);
+		 }
+		 list_group_retag(list_ptr, old_channel, new_channel);
+	 }
+	 else if (list_column_groups(list_ptr) > new_channel
+			 && (match = sas_column_match(list_ptr, old_channel, &count_moved)) != NULL) {
+		 // only the matching users are loaded; the column is blended after
+		 for (i = 0; i < count_moved; i++) {
+			 list_access(list_ptr, match[i])->channel = new_channel;
+		 }
+		 list_column_retag(list_ptr, old_channel, new_channel);
+	 }
+	 else {
+		 listTop = list_size(list_ptr);
+		 rover = list_iter_front(list_ptr);
+	 }
+	 for (i = 0; i < listTop; i++) {
 		 if (list_access(list_ptr, rover)->channel == old_channel) {
 			 list_access(list_ptr, rover)->channel = new_channel;
 			 count_moved++;
@@ -361,11 +563,12 @@ void sas_change(ListPtr list_ptr, int old_channel, int new_channel)
 	 }
 
     if (count_moved == 0) {
-        printf("Did not find any users on channel %d\n", old_channel);
+        output_printf("Did not find any users on channel %d\n", old_channel);
     } else {
-        printf("Moved %d users from channel %d to %d\n", count_moved, 
+        output_printf("Moved %d users from channel %d to %d\n", count_moved, 
                 old_channel, new_channel);
     }
+	 list_unlock(list_ptr);
 	 rover = NULL;
 }
 
@@ -389,6 +592,10 @@ void sas_assign(ListPtr assn_ptr, int size, ListPtr wait_q, int channel)
     su_info_t *rec_ptr = NULL;
     int assign_action = -2;
 
+	 list_lock_pair(assn_ptr, wait_q, LIST_WRITE);
+	 if (list_size(wait_q) == 0) {
+		 list_drain(wait_q); // take the next batch of ADDTAILs
+	 }
 	 if (list_size(wait_q) == 0) { // wait queue empty
 		 assign_action = 0;
 	 }
@@ -396,24 +603,79 @@ void sas_assign(ListPtr assn_ptr, int size, ListPtr wait_q, int channel)
 		 assign_action = 1;
 	 }
 	 else {
-		 rec_ptr = list_remove(wait_q, NULL);
-		 list_insert_sorted(assn_ptr, rec_ptr);
+		 rec_ptr = list_access(wait_q, list_iter_front(wait_q));
+		 // set the channel first, the channel index files it by channel
 		 rec_ptr->channel = channel;
+		 list_transfer_sorted(assn_ptr, wait_q, NULL);
 		 assign_action = 2;
 	 }
  
     if (assign_action == 0) {
-        printf("No secondary users are waiting\n");
+        output_printf("No secondary users are waiting\n");
     } else if (assign_action == 1) {
-        printf("User(s) waiting but the assigned list is full %d\n", size);
+        output_printf("User(s) waiting but the assigned list is full %d\n", size);
     } else if (assign_action == 2) {
-        printf("Moved waiting SU %d to channel: %d\n", rec_ptr->su_id, channel);
+        output_printf("Moved waiting SU %d to channel: %d\n", rec_ptr->su_id, channel);
     } else {
-        printf("Error with assign action flag!\n");
+        output_printf("Error with assign action flag!\n");
     }
+	 list_unlock_pair(assn_ptr, wait_q);
     rec_ptr = NULL;
 }
 
+/* Assign up to count secondary users from the head of the waiting queue
+ * to a channel, as if by count ASSIGNSU commands.
+ *
+ * The users that fit in the assigned list are given the channel and then
+ * merged into it together with list_merge_sorted, so the assigned list is
+ * walked once for the whole batch instead of once per user.  If fewer than
+ * count users were moved, the reason is printed once.
+ */
+void sas_assign_batch(ListPtr assn_ptr, int size, ListPtr wait_q, int channel, int count)
+{
+	// NULL list will cause assert to fail in list functions below
+	if ((assn_ptr == NULL) || (wait_q == NULL)) {
+		return;
+	}
+
+	 IteratorPtr rover;
+	 su_info_t *rec_ptr = NULL;
+	 int batch = count;
+	 int i;
+
+	 list_lock_pair(assn_ptr, wait_q, LIST_WRITE);
+	 if (list_size(wait_q) < count) {
+		 list_drain(wait_q); // take the next batch of ADDTAILs
+	 }
+	 if (batch > size - list_size(assn_ptr)) {
+		 batch = size - list_size(assn_ptr);
+	 }
+	 if (batch > list_size(wait_q)) {
+		 batch = list_size(wait_q);
+	 }
+
+	 // set the channel first, the channel index files it by channel
+	 rover = list_iter_front(wait_q);
+	 for (i = 0; i < batch; i++) {
+		 rec_ptr = list_access(wait_q, rover);
+		 rec_ptr->channel = channel;
+		 output_printf("Moved waiting SU %d to channel: %d\n", rec_ptr->su_id, channel);
+		 rover = list_iter_next(rover);
+	 }
+	 list_merge_sorted(assn_ptr, wait_q, batch);
+
+	 if (batch < count) {
+		 if (list_size(wait_q) == 0) {
+			 output_printf("No secondary users are waiting\n");
+		 } else {
+			 output_printf("User(s) waiting but the assigned list is full %d\n", size);
+		 }
+	 }
+	 list_unlock_pair(assn_ptr, wait_q);
+	 rover = NULL;
+	 rec_ptr = NULL;
+}
+
 /* print count of records in the assigned list and waiting queue
  */
 void sas_stats(ListPtr sorted, int sorted_size, ListPtr unsorted)
@@ -424,11 +686,202 @@ void sas_stats(ListPtr sorted, int sorted_size, ListPtr unsorted)
 	}
 
     // get the number in list and size of the list
+    list_lock_pair(sorted, unsorted, LIST_READ);
     int num_in_list = list_size(sorted); 
-    int num_in_queue = list_size(unsorted);
-    printf("List records:  %d, Max list size: %d  ", 
+    int num_in_queue = list_size(unsorted) + list_pending(unsorted);
+    list_unlock_pair(sorted, unsorted);
+    output_printf("List records:  %d, Max list size: %d  ", 
             num_in_list, sorted_size);
-    printf("Queue records: %d\n", num_in_queue);
+    output_printf("Queue records: %d\n", num_in_queue);
+}
+
+/* Prints the operation counters of a list and sets them back to zero.
+ *
+ * The counters are only kept when list.c is built with LIST_PERF (make
+ * PERF=1); otherwise a note saying so is printed.  Sort counts are shown
+ * for the sort types that were used.
+ */
+void sas_perf(ListPtr list_ptr, const char *list_type)
+{
+    list_perf_t perf;
+    int i;
+
+	 if (list_ptr == NULL) {
+		 return;
+	 }
+	 list_lock(list_ptr, LIST_WRITE);
+	 i = list_perf_read(list_ptr, &perf);
+	 list_perf_reset(list_ptr);
+	 list_unlock(list_ptr);
+	 sas_perf_print(&perf, i, list_type);
+}
+
+/* Prints operation counters read with list_perf_read, or added up over
+ * several lists.  kept is what list_perf_read returned.
+ */
+void sas_perf_print(const list_perf_t *perf, int kept, const char *list_type)
+{
+    int i;
+
+	 if (!kept) {
+		 output_printf("%s: counters not compiled in, rebuild with make PERF=1\n",
+				 list_type);
+		 return;
+	 }
+	 output_printf("%s: compares %lu, find visits %lu, insert visits %lu\n",
+			 list_type, perf->comparisons, perf->find_visits, perf->insert_visits);
+	 output_printf("   malloc %lu, free %lu, pool alloc %lu, pool free %lu\n",
+			 perf->mallocs, perf->frees, perf->pool_allocs, perf->pool_frees);
+	 output_printf("   sorts by type:");
+	 for (i = 0; i <= LIST_SORT_TYPES; i++) {
+		 if (perf->sorts[i] > 0) {
+			 output_printf(" %d:%lu", i, perf->sorts[i]);
+		 }
+	 }
+	 output_printf("\n");
+}
+
+/* Write both lists to a snapshot file that sas_load can restore.
+ *
+ * The snapshot is written to "file.tmp", synced, and renamed over file, so
+ * an earlier snapshot is never left half written.  The header holds the 
+ * size limit, the record counts, the sorted state of each list and a 
+ * checksum of the records.
+ */
+void sas_save(ListPtr assn_ptr, int size, ListPtr wait_q, const char *file)
+{
+    sas_snap_header_t head;
+    char tmp_name[MAXLINE + 8];
+    FILE *fp;
+    int failed;
+
+	 if ((assn_ptr == NULL) || (wait_q == NULL)) {
+		 output_printf("Cannot save %s: no lists created\n", file);
+		 return;
+	 }
+	 sas_drain(wait_q);
+	 list_lock_pair(assn_ptr, wait_q, LIST_READ);
+	 memset(&head, 0, sizeof(head));
+	 memcpy(head.magic, SAS_SNAP_MAGIC, sizeof(SAS_SNAP_MAGIC));
+	 head.version = SAS_SNAP_VERSION;
+	 head.record_size = sizeof(su_info_t);
+	 head.sorted_size = size;
+	 head.assigned_count = list_size(assn_ptr);
+	 head.waiting_count = list_size(wait_q);
+	 if (list_is_sorted(assn_ptr)) {
+		 head.sorted_flags |= SAS_SNAP_ASSIGNED_SORTED;
+	 }
+	 if (list_is_sorted(wait_q)) {
+		 head.sorted_flags |= SAS_SNAP_WAITING_SORTED;
+	 }
+
+	 snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", file);
+	 fp = fopen(tmp_name, "wb");
+	 if (fp == NULL) {
+		 list_unlock_pair(assn_ptr, wait_q);
+		 output_printf("Cannot save %s: %s\n", file, strerror(errno));
+		 return;
+	 }
+	 setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+	 // the header is written again once the checksum is known
+	 failed = (fwrite(&head, sizeof(head), 1, fp) != 1)
+		 || sas_save_list(fp, assn_ptr, &head.checksum)
+		 || sas_save_list(fp, wait_q, &head.checksum)
+		 || fseek(fp, 0, SEEK_SET) != 0
+		 || (fwrite(&head, sizeof(head), 1, fp) != 1)
+		 || fflush(fp) != 0
+		 || fsync(fileno(fp)) != 0;
+	 list_unlock_pair(assn_ptr, wait_q);
+	 if (fclose(fp) != 0 || failed || rename(tmp_name, file) != 0) {
+		 output_printf("Cannot save %s: %s\n", file, strerror(errno));
+		 unlink(tmp_name);
+		 return;
+	 }
+	 output_printf("Saved %d assigned and %d waiting users to %s\n", 
+			 head.assigned_count, head.waiting_count, file);
+}
+
+/* Restore both lists from a snapshot file written by sas_save.
+ *
+ * The file is mapped into memory and checked before anything changes: the
+ * header must match this build, the file size must match the counts, the
+ * checksum must match, and every record must be one the commands could 
+ * have made.  Each list is then built in one pass with list_append_bulk,
+ * sorted or not as the header's sorted_flags say, which also checks that a
+ * list saved as sorted is still in order.
+ *
+ * New lists are made with the given modes, and replace *assn_ptr and
+ * *wait_ptr only if the load succeeds.  Returns the size limit of the
+ * assigned list, or -1 if the file was not loaded.
+ */
+int sas_load(const char *file, ListPtr *assn_ptr, ListPtr *wait_ptr,
+        int assn_mode, int wait_mode, int index_channels)
+{
+    const sas_snap_header_t *head;
+    const su_info_t *records;
+    const char *problem = NULL;
+    ListPtr assigned, waiting;
+    struct stat info;
+    void *map;
+    int fd, size;
+
+	 fd = open(file, O_RDONLY);
+	 if (fd < 0 || fstat(fd, &info) != 0) {
+		 output_printf("Cannot load %s: %s\n", file, strerror(errno));
+		 if (fd >= 0) {
+			 close(fd);
+		 }
+		 return -1;
+	 }
+	 if (info.st_size < (off_t) sizeof(sas_snap_header_t)) {
+		 output_printf("Cannot load %s: not a snapshot\n", file);
+		 close(fd);
+		 return -1;
+	 }
+	 map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	 close(fd);
+	 if (map == MAP_FAILED) {
+		 output_printf("Cannot load %s: %s\n", file, strerror(errno));
+		 return -1;
+	 }
+	 madvise(map, info.st_size, MADV_SEQUENTIAL);
+
+	 head = (const sas_snap_header_t *) map;
+	 problem = sas_load_check(head, info.st_size);
+	 if (problem != NULL) {
+		 output_printf("Cannot load %s: %s\n", file, problem);
+		 munmap(map, info.st_size);
+		 return -1;
+	 }
+
+	 records = (const su_info_t *) (head + 1);
+	 assigned = list_construct_mode(sas_compare, sas_key, assn_mode, NULL);
+	 sas_index_channels(assigned, index_channels);
+	 waiting = list_construct_mode(sas_compare, sas_key, wait_mode, assigned);
+	 list_append_bulk(assigned, records, head->assigned_count, 1);
+	 list_append_bulk(waiting, records + head->assigned_count, head->waiting_count,
+			 (head->sorted_flags & SAS_SNAP_WAITING_SORTED) != 0);
+
+	 if (!list_is_sorted(assigned) || (!list_is_sorted(waiting)
+				 && (head->sorted_flags & SAS_SNAP_WAITING_SORTED))) {
+		 output_printf("Cannot load %s: list saved as sorted is out of order\n", file);
+		 list_destruct(waiting);
+		 list_destruct(assigned);
+		 munmap(map, info.st_size);
+		 return -1;
+	 }
+
+	 output_printf("Loaded %d assigned and %d waiting users from %s\n", 
+			 head->assigned_count, head->waiting_count, file);
+	 output_printf("Assignment list size limit: %d\n", head->sorted_size);
+	 sas_cleanup(*wait_ptr);
+	 sas_cleanup(*assn_ptr);
+	 *assn_ptr = assigned;
+	 *wait_ptr = waiting;
+	 size = head->sorted_size;
+	 munmap(map, info.st_size);
+	 return size;
 }
 
 /* this function frees the memory for either a sorted or unsorted list.
@@ -459,31 +912,51 @@ int sas_invalid_ch(int channel_num)
  * L: the list to be sorted.
  * sort_type: the type of sort to use. This value will be interpreted by
  *					the functions in list.c.
+ * threads: threads for the parallel sort, or 0 for one per processor.
+ *
+ * Prints the list size, the CPU time in milliseconds, the sort type, and
+ * the wall clock time in milliseconds.  The CPU time from clock() adds up
+ * every thread, so only the wall clock time shows a parallel speedup.
  */
-void sas_sort(ListPtr L, int sort_type) {
+void sas_sort(ListPtr L, int sort_type, int threads) {
 	if (L == NULL) {
 		return;
 	}
 
 	clock_t start, end;
+	struct timespec wall_start, wall_end;
 	double elapse_time; /* time in milliseconds */
+	double wall_time;   /* time in milliseconds */
 
+	list_lock(L, LIST_WRITE);
+	list_drain(L);
 	int initialsize = list_size(L);
+	list_set_sort_threads(L, threads);
+	clock_gettime(CLOCK_MONOTONIC, &wall_start);
 	start = clock();
 	list_sort(L, sort_type);
 	end = clock();
+	clock_gettime(CLOCK_MONOTONIC, &wall_end);
 	elapse_time = 1000.0 * ((double) (end - start)) / CLOCKS_PER_SEC;
+	wall_time = 1000.0 * (wall_end.tv_sec - wall_start.tv_sec)
+		+ (wall_end.tv_nsec - wall_start.tv_nsec) / 1000000.0;
 	
 	// sas_print(L, "Waiting Queue"); // for debugging
 	
 	assert(list_size(L) == initialsize);
-	printf("%d\t%f\t%d\n", initialsize, elapse_time, sort_type);
+	list_unlock(L);
+	output_printf("%d\t%f\t%d\t%f\n", initialsize, elapse_time, sort_type, wall_time);
 }
 
 /* Adds a new entry to the tail of the given list. The data of
  * the new entry is not collected, only the su_id, which is passed
  * to the function as an argument.
  *
+ * A LIST_INBOX list takes the entry with list_push, which needs no lock,
+ * so several threads may add to it at once.  It is linked in when a 
+ * command needs the whole queue, or when ASSIGNSU has used up the users
+ * linked in before.
+ *
  * list_ptr: the list which a new tail is to be added to.
  * new_id: the su_id of the new entry to be added.
  */
@@ -493,9 +966,13 @@ void sas_addtail(ListPtr list_ptr, int new_id) {
 	}
 
     su_info_t *rec_ptr;
-    rec_ptr = (su_info_t *) calloc(1, sizeof(su_info_t));
+    rec_ptr = list_elem_alloc(list_ptr);   // a shared pool locks itself
 	 rec_ptr->su_id = new_id;
-	 list_insert(list_ptr, rec_ptr, NULL);
+	 if (!list_push(list_ptr, rec_ptr)) {
+		 list_lock(list_ptr, LIST_WRITE);
+		 list_insert(list_ptr, rec_ptr, NULL);
+		 list_unlock(list_ptr);
+	 }
 }
 
 /* Prompts user for secondary record input starting with the SU ID.
@@ -513,26 +990,26 @@ void sas_record_fill(su_info_t *new)
     char str[MAXLINE];
     assert(new != NULL);
 
-    printf("secondary user ID number:");
-    fgets(line, MAXLINE, stdin);
+    output_printf("secondary user ID number:");
+    input_line(line, MAXLINE);
     sscanf(line, "%d", &new->su_id);
-    printf("IP address:");
-    fgets(line, MAXLINE, stdin);
+    output_printf("IP address:");
+    input_line(line, MAXLINE);
     sscanf(line, "%d", &new->ip_address);
-    printf("Access point IP address:");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Access point IP address:");
+    input_line(line, MAXLINE);
     sscanf(line, "%d", &new->access_point);
 
-    printf("Authenticated (T/F):");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Authenticated (T/F):");
+    input_line(line, MAXLINE);
     sscanf(line, "%s", str);
     if (strcmp(str, "T")==0 || strcmp(str, "t")==0)
         new->authenticated = 1;
     else
         new->authenticated = 0;
 
-    printf("Privacy (none|standard|strong|NSA):");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Privacy (none|standard|strong|NSA):");
+    input_line(line, MAXLINE);
     sscanf(line, "%s", str);
     if (strcmp(str, "standard")==0)
 	new->privacy = 1;
@@ -543,40 +1020,155 @@ void sas_record_fill(su_info_t *new)
     else
 	new->privacy = 0;
 
-    printf("Band (2.4|5.0):");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Band (2.4|5.0):");
+    input_line(line, MAXLINE);
     sscanf(line, "%f", &new->band);
 
-    printf("Channel:");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Channel:");
+    input_line(line, MAXLINE);
     sscanf(line, "%d", &new->channel);
     if (sas_invalid_ch(new->channel))
         new->channel = 10;
 
-    printf("Data rate:");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Data rate:");
+    input_line(line, MAXLINE);
     sscanf(line, "%f", &new->data_rate);
 
-    printf("Time received (int):");
-    fgets(line, MAXLINE, stdin);
+    output_printf("Time received (int):");
+    input_line(line, MAXLINE);
     sscanf(line, "%d", &new->time_received);
-    printf("\n");
+    output_printf("\n");
 }
 
 /* print the information for a particular secondary user record 
  *
  * Input is a pointer to a record, and no entries are changed.
+ *
+ * The text goes to the output buffer, in the same format as
+ *   "ID: %d, C: %d, MIP: %d, AID: %d, Auth: %s, Pri: %s, B: %g, R: %g Time: %d\n"
+ * so the caller must call output_flush before it prints anything else.
  */
-void sas_record_print(su_info_t *rec)
+void sas_record_print(const su_info_t *rec)
 {
     const char *pri_str[] = {"none", "standard", "strong", "NSA"};
     assert(rec != NULL);
-    printf("ID: %d, C: %d,", rec->su_id, rec->channel);
-    printf(" MIP: %d, AID: %d,", rec->ip_address, 
-            rec->access_point);
-    printf(" Auth: %s,", rec->authenticated ? "T" : "F"); 
-    printf(" Pri: %s, B: %g,", pri_str[rec->privacy], rec->band);
-    printf(" R: %g", rec->data_rate);
-    printf(" Time: %d\n", rec->time_received);
+    output_text("ID: ");
+    output_int(rec->su_id);
+    output_text(", C: ");
+    output_int(rec->channel);
+    output_text(", MIP: ");
+    output_int(rec->ip_address);
+    output_text(", AID: ");
+    output_int(rec->access_point);
+    output_text(rec->authenticated ? ", Auth: T, Pri: " : ", Auth: F, Pri: ");
+    output_text(pri_str[rec->privacy]);
+    output_text(", B: ");
+    output_float(rec->band);
+    output_text(", R: ");
+    output_float(rec->data_rate);
+    output_text(" Time: ");
+    output_int(rec->time_received);
+    output_text("\n");
+}
+
+/* Adds records to a checksum of 32 bit words, FNV-1a style.  Start with a
+ * sum of 0.
+ */
+unsigned int sas_checksum(unsigned int sum, const su_info_t *rec, int count)
+{
+    const unsigned char *bytes = (const unsigned char *) rec;
+    size_t i, length = (size_t) count * sizeof(su_info_t);
+    unsigned int word;
+
+    if (sum == 0) {
+        sum = 2166136261u;
+    }
+    for (i = 0; i + sizeof(word) <= length; i += sizeof(word)) {
+        memcpy(&word, bytes + i, sizeof(word));
+        sum = (sum ^ word) * 16777619u;
+    }
+    for (; i < length; i++) {
+        sum = (sum ^ bytes[i]) * 16777619u;
+    }
+    return sum;
+}
+
+/* Writes the records of a list to a snapshot file, in list order, and
+ * adds them to the checksum.  Returns 0, or 1 if a write failed.
+ */
+int sas_save_list(FILE *fp, ListPtr list_ptr, unsigned int *sum)
+{
+    IteratorPtr rover;
+    su_info_t *rec_ptr;
+
+    for (rover = list_iter_front(list_ptr); rover != NULL; rover = list_iter_next(rover)) {
+        rec_ptr = list_access(list_ptr, rover);
+        *sum = sas_checksum(*sum, rec_ptr, 1);
+        if (fwrite(rec_ptr, sizeof(su_info_t), 1, fp) != 1) {
+            return 1;
+        }
+    }
+    return 0;
 }
 
+/* Checks the header and records of a mapped snapshot file of the given
+ * size.  Returns NULL if it can be loaded, or what is wrong with it.
+ */
+const char *sas_load_check(const sas_snap_header_t *head, size_t bytes)
+{
+    const su_info_t *rec = (const su_info_t *) (head + 1);
+    size_t count;
+    size_t i;
+
+    if (memcmp(head->magic, SAS_SNAP_MAGIC, sizeof(SAS_SNAP_MAGIC)) != 0) {
+        return "not a snapshot";
+    }
+    if (head->version != SAS_SNAP_VERSION || head->record_size != sizeof(su_info_t)) {
+        return "snapshot from a different version";
+    }
+    if (head->sorted_size < 1 || head->assigned_count < 0 || head->waiting_count < 0
+            || head->assigned_count > head->sorted_size
+            || (head->sorted_flags & SAS_SNAP_ASSIGNED_SORTED) == 0) {
+        return "bad header";
+    }
+    count = (size_t) head->assigned_count + (size_t) head->waiting_count;
+    if (bytes != sizeof(sas_snap_header_t) + count * sizeof(su_info_t)) {
+        return "file size does not match header";
+    }
+    if (sas_checksum(0, rec, (int) count) != head->checksum) {
+        return "checksum mismatch";
+    }
+    for (i = 0; i < count; i++) {
+        if (rec[i].privacy < 0 || rec[i].privacy > 3) {
+            return "bad record";
+        }
+        if (i < (size_t) head->assigned_count && sas_invalid_ch(rec[i].channel)) {
+            return "bad channel in assigned list";
+        }
+    }
+    return NULL;
+}
+
+/* Returns the users on a channel in list order, with their number in
+ * *count, or NULL if the list has no channel column.  The array belongs to
+ * the list and is reused by its next match, so it is not freed.
+ */
+IteratorPtr * sas_column_match(ListPtr list_ptr, int channel, int *count)
+{
+	 if (list_column_groups(list_ptr) <= channel) {
+		 return NULL;
+	 }
+	 return list_column_match(list_ptr, channel, count);
+}
+
+/* Links in the users pushed on a LIST_INBOX list, for a command that reads
+ * the whole list in order under the read lock.
+ */
+void sas_drain(ListPtr list_ptr)
+{
+	 if (list_pending(list_ptr) > 0) {
+		 list_lock(list_ptr, LIST_WRITE);
+		 list_drain(list_ptr);
+		 list_unlock(list_ptr);
+	 }
+}
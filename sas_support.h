@@ -11,28 +11,47 @@
  */
 
 #define MAXLINE 180
+#define SAS_MAX_CHANNEL 10   // channels are 1 to SAS_MAX_CHANNEL
+#define SAS_RECORD_LINES 9   // lines of input sas_record_fill reads
+
+// how sas_index_channels finds the users on a channel
+#define SAS_INDEX_NONE   0   // scan the whole assigned list
+#define SAS_INDEX_CHAINS 1   // one chain of nodes per channel
+#define SAS_INDEX_COLUMN 2   // SIMD scan of a column of channels
 
 // prototype function definitions 
 
 // function to compare secondary user records 
 int sas_compare(const su_info_t *rec_a, const su_info_t *rec_b);
+int sas_key(const su_info_t *rec);
+int sas_channel(const su_info_t *rec);
 
 // functions to create and cleanup a list 
-ListPtr sas_create(ListPtr, const char *);
+ListPtr sas_create(ListPtr, const char *, ListPtr, int);
 void sas_cleanup(ListPtr);
+void sas_index_channels(ListPtr, int);
 
 void sas_print(ListPtr list_ptr, char *);      // print list of records 
+void sas_print_array(const su_info_t *, int, const char *);
 void sas_stats(ListPtr, int, ListPtr);
+void sas_perf(ListPtr, const char *);
+void sas_perf_print(const list_perf_t *, int, const char *);
 int sas_invalid_ch(int);
 
 void sas_add(ListPtr, int, ListPtr);
+void sas_add_rec(ListPtr, int, ListPtr, const su_info_t *);
+void sas_record_fill(su_info_t *rec);   // collect input from user 
 void sas_lookup(ListPtr , int);
+void sas_lookup_array(const su_info_t *, int, int, int);
 void sas_remove(ListPtr, ListPtr, int);
 void sas_move(ListPtr, int, ListPtr);
 void sas_change(ListPtr, int, int);
 void sas_assign(ListPtr, int, ListPtr, int);
+void sas_assign_batch(ListPtr, int, ListPtr, int, int);
 
 // new functions for lab 3
-void sas_sort(ListPtr, int);
+void sas_sort(ListPtr, int, int);
 void sas_addtail(ListPtr, int);
+void sas_save(ListPtr, int, ListPtr, const char *);
+int sas_load(const char *, ListPtr *, ListPtr *, int, int, int);
 
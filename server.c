@@ -0,0 +1,393 @@
+/* server.c
+ * MP3
+ *
+ * Purpose: This file lets many clients share one set of lists.  lab3 -u
+ *		listens on a Unix domain socket and serves every client from one
+ *		thread with a nonblocking epoll event loop, so no client waits on
+ *		another's slow reads or writes.
+ *
+ *		Clients speak the same line protocol as standard input.  Each
+ *		connection has an input buffer, holding what it sent and has not
+ *		been run, and an output buffer, holding replies not yet sent.  A
+ *		client may pipeline commands: all the whole commands read at once
+ *		are passed to the run callback together and run in order, with their
+ *		output captured into the output buffer of the connection, which is
+ *		then sent with as few writes as the socket allows.
+ *
+ * Assumptions: A command ends at a newline, except that ADDSU also takes
+ *		the lines of its record; the lines callback says how many lines a
+ *		command takes, and a command is only run once all of them arrived.
+ *		Text after the last newline is run when the client closes its side.
+ *		A client whose replies back up past SERVER_OUT_MAX is not read from,
+ *		and has no more of its commands run, until it takes them, so a
+ *		client that never reads cannot make the server hold its replies
+ *		without limit.  One read of commands may take it past the limit.
+ *
+ * Bugs: None known.
+ */
+
+// for accept4
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "output.h"
+#include "server.h"
+
+// one client connection
+typedef struct server_conn_tag {
+    int fd;
+    char *in;               // bytes read and not yet run
+    int in_used;
+    int in_size;
+    int in_done;            // 1 once the client closed its side
+    int quit;               // 1 once QUIT ran; nothing more is run
+    output_buf_t out;       // replies, sent from out.text + out_sent
+    size_t out_sent;
+    unsigned int events;    // the epoll events asked for
+    struct server_conn_tag *prev;   // chain of open connections
+    struct server_conn_tag *next;
+} server_conn_t;
+
+// Private functions used in this file only.
+int ServerListen(const char *path);
+void ServerAccept(int ep, int listen_fd);
+int ServerRead(server_conn_t *C);
+void ServerRunInput(server_conn_t *C, server_run_t run, server_lines_t lines,
+        void *state);
+int ServerLineEnd(server_conn_t *C, int pos);
+int ServerCommandEnd(server_conn_t *C, int pos, server_lines_t lines, void *state);
+int ServerWrite(server_conn_t *C);
+int ServerWatch(int ep, server_conn_t *C);
+void ServerClose(int ep, server_conn_t *C);
+void ServerSignal(int signal_no);
+
+static volatile sig_atomic_t server_stopping = 0;
+static server_conn_t *server_conns = NULL;
+
+/* Serves clients on a Unix domain socket at path until SIGINT or SIGTERM.
+ *
+ * run: runs whole commands a client sent, with output captured for it.
+ *      When it returns 0 the replies are sent and the connection closed.
+ * lines: says how many lines the command on a line takes.
+ * idle: called, if not NULL, each time before the server waits.
+ *
+ * A file already at path is replaced, and removed when the server stops.
+ * Returns 0 once stopped by a signal, or -1 with errno set if the socket
+ * cannot be set up.
+ */
+int server_run(const char *path, server_run_t run, server_lines_t lines,
+        server_idle_t idle, void *state)
+{
+    struct epoll_event events[SERVER_EVENTS];
+    struct epoll_event ev;
+    struct sigaction action;
+    server_conn_t *C;
+    int listen_fd, ep, count, i;
+
+    listen_fd = ServerListen(path);
+    if (listen_fd < 0) {
+        return -1;
+    }
+    ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        close(listen_fd);
+        return -1;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // the listening socket
+    epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    // no SA_RESTART, so a signal ends the wait in epoll_wait
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = ServerSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    while (!server_stopping) {
+        if (idle != NULL) {
+            idle(state);
+        }
+        count = epoll_wait(ep, events, SERVER_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (i = 0; i < count; i++) {
+            C = (server_conn_t *) events[i].data.ptr;
+            if (C == NULL) {
+                ServerAccept(ep, listen_fd);
+                continue;
+            }
+            if ((events[i].events & EPOLLERR)
+                    || ((events[i].events & EPOLLHUP) && !(events[i].events & EPOLLIN))) {
+                ServerClose(ep, C);
+                continue;
+            }
+            if ((events[i].events & EPOLLIN) && ServerRead(C) < 0) {
+                ServerClose(ep, C);
+                continue;
+            }
+            ServerRunInput(C, run, lines, state);
+            if (ServerWrite(C) < 0 || ServerWatch(ep, C) == 0) {
+                ServerClose(ep, C);
+            }
+        }
+    }
+
+    while (server_conns != NULL) {
+        ServerClose(ep, server_conns);
+    }
+    close(ep);
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
+
+/*** Private Functions ***/
+
+/* Creates a nonblocking socket listening at path.  Returns it, or -1.
+ */
+int ServerListen(const char *path) {
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path); // left by a server that did not stop cleanly
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+            || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Accepts every client waiting on the listening socket.
+ */
+void ServerAccept(int ep, int listen_fd) {
+    struct epoll_event ev;
+    server_conn_t *C;
+    int fd;
+
+    for (;;) {
+        fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return; // EAGAIN once all are taken, or the client gave up
+        }
+        C = (server_conn_t *) calloc(1, sizeof(server_conn_t));
+        C->fd = fd;
+        C->events = EPOLLIN;
+        ev.events = C->events;
+        ev.data.ptr = C;
+        if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            close(fd);
+            free(C);
+            continue;
+        }
+        C->next = server_conns;
+        if (server_conns != NULL) {
+            server_conns->prev = C;
+        }
+        server_conns = C;
+    }
+}
+
+/* Reads one block from the client onto its input buffer.  Only one read
+ * is made, so a busy client cannot keep the others waiting.
+ *
+ * Returns 0, or -1 if the connection failed.
+ */
+int ServerRead(server_conn_t *C) {
+    ssize_t got;
+
+    if (C->in_size - C->in_used < SERVER_READ_BLOCK) {
+        C->in_size = C->in_used + SERVER_READ_BLOCK;
+        C->in = (char *) realloc(C->in, C->in_size);
+    }
+    do {
+        got = read(C->fd, C->in + C->in_used, SERVER_READ_BLOCK);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    }
+    if (got == 0) {
+        C->in_done = 1;
+    }
+    C->in_used += (int) got;
+    return 0;
+}
+
+/* Runs the whole commands in the input buffer, in order, capturing their
+ * output into the output buffer.  They are all passed to run at once, so
+ * it may keep several going at a time, as lab3 -n does with its shards.
+ * Nothing is run while the replies are past SERVER_OUT_MAX.
+ */
+void ServerRunInput(server_conn_t *C, server_run_t run, server_lines_t lines,
+        void *state) {
+    int end = 0;
+    int next;
+
+    if (C->quit || C->out.used - C->out_sent >= SERVER_OUT_MAX) {
+        return;
+    }
+    while ((next = ServerCommandEnd(C, end, lines, state)) > end) {
+        end = next;
+    }
+    if (end == 0) {
+        return;
+    }
+    output_capture(&C->out);
+    if (!run(state, C->in, end)) {
+        C->quit = 1;
+        end = C->in_used; // nothing after QUIT is run
+    }
+    output_capture(NULL);
+
+    memmove(C->in, C->in + end, C->in_used - end);
+    C->in_used -= end;
+}
+
+/* Returns the position after the line starting at pos, or -1 if its
+ * newline has not arrived.  After the client closed its side, the last
+ * line ends at the end of the input.
+ */
+int ServerLineEnd(server_conn_t *C, int pos) {
+    char *newline = (char *) memchr(C->in + pos, '\n', C->in_used - pos);
+
+    if (newline != NULL) {
+        return (int) (newline - C->in) + 1;
+    }
+    if (C->in_done && pos < C->in_used) {
+        return C->in_used;
+    }
+    return -1;
+}
+
+/* Returns the position after the command starting at pos, with all the
+ * lines it takes, or -1 if they have not all arrived.
+ */
+int ServerCommandEnd(server_conn_t *C, int pos, server_lines_t lines, void *state) {
+    int end = ServerLineEnd(C, pos);
+    int count;
+
+    if (end < 0) {
+        return -1;
+    }
+    count = lines(state, C->in + pos, end - pos);
+    while (--count > 0 && end < C->in_used) {
+        end = ServerLineEnd(C, end);
+        if (end < 0) {
+            return -1;
+        }
+    }
+    if (count > 0 && !C->in_done) {
+        return -1;
+    }
+    return end;
+}
+
+/* Sends as much of the output buffer as the socket takes without waiting.
+ * Returns 0, or -1 if the connection failed.
+ */
+int ServerWrite(server_conn_t *C) {
+    ssize_t sent;
+
+    while (C->out_sent < C->out.used) {
+        sent = send(C->fd, C->out.text + C->out_sent, C->out.used - C->out_sent,
+                MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        C->out_sent += sent;
+    }
+    // all sent: start again at the front, and give back a large buffer
+    C->out.used = 0;
+    C->out_sent = 0;
+    if (C->out.size > SERVER_OUT_MAX) {
+        free(C->out.text);
+        C->out.text = NULL;
+        C->out.size = 0;
+    }
+    return 0;
+}
+
+/* Asks epoll for the events the connection now waits for: input unless
+ * the client is done or too far behind on its replies, and room to write
+ * while replies are waiting.
+ *
+ * Returns 0 if the connection has nothing left to do and can be closed,
+ * or 1.
+ */
+int ServerWatch(int ep, server_conn_t *C) {
+    struct epoll_event ev;
+    unsigned int events = 0;
+    size_t waiting = C->out.used - C->out_sent;
+
+    if (!C->quit && !C->in_done && waiting < SERVER_OUT_MAX) {
+        events |= EPOLLIN;
+    }
+    if (waiting > 0) {
+        events |= EPOLLOUT;
+    }
+    if (events == 0) {
+        // quit, or closed with every whole command run and answered
+        return 0;
+    }
+    if (events != C->events) {
+        C->events = events;
+        ev.events = events;
+        ev.data.ptr = C;
+        epoll_ctl(ep, EPOLL_CTL_MOD, C->fd, &ev);
+    }
+    return 1;
+}
+
+/* Closes the connection and frees its buffers.
+ */
+void ServerClose(int ep, server_conn_t *C) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, C->fd, NULL);
+    close(C->fd);
+    if (C->prev != NULL) {
+        C->prev->next = C->next;
+    }
+    else {
+        server_conns = C->next;
+    }
+    if (C->next != NULL) {
+        C->next->prev = C->prev;
+    }
+    free(C->in);
+    free(C->out.text);
+    free(C);
+}
+
+/* Handler for SIGINT and SIGTERM: the event loop stops after this wait.
+ */
+void ServerSignal(int signal_no) {
+    server_stopping = 1;
+}
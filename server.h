@@ -0,0 +1,33 @@
+/* server.h
+ * MP3
+ *
+ * Purpose: Public functions for serving the line protocol of lab3 to many
+ * clients at once over a Unix domain socket.
+ *
+ * Assumptions: The commands are run one at a time on the thread that
+ * calls server_run, with output captured by output.c for each client.
+ *
+ * Bugs:
+ */
+
+// bytes read from a client at a time
+#define SERVER_READ_BLOCK 65536
+
+// replies waiting for a client past which no more of its commands are run
+#define SERVER_OUT_MAX (4 << 20)
+
+// events taken from epoll_wait at a time
+#define SERVER_EVENTS 64
+
+// runs the whole commands in text, which may be several pipelined ones,
+// and returns 0 if the client asked to quit
+typedef int (*server_run_t)(void *state, const char *text, int length);
+
+// returns the number of lines the command on line takes, with its input
+typedef int (*server_lines_t)(void *state, const char *line, int length);
+
+// called before the server waits for more input
+typedef void (*server_idle_t)(void *state);
+
+int server_run(const char *path, server_run_t run, server_lines_t lines,
+        server_idle_t idle, void *state);
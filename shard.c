@@ -0,0 +1,937 @@
+/* shard.c
+ * MP3
+ *
+ * Purpose: This file splits the lists of the SAS application into shards
+ *		so the commands can use more than one core.  A user is kept in the
+ *		shard its su_id hashes to, and each shard has its own assigned list,
+ *		waiting queue and worker thread, so only that thread touches them.
+ *
+ *		The dispatcher (the thread that reads the commands) turns each
+ *		command into a part for every shard it concerns and adds the parts
+ *		to the queues of those shards.  A command about one user, such as
+ *		ADDTAIL or DELSU, goes to one shard.  A command about all the users,
+ *		such as STATS or CLEARCH, is scattered to every shard, and the
+ *		results of the parts are gathered into one reply when the command
+ *		is written out.  Each part prints into a buffer of its own;
+ *		shard_flush writes the replies in the order the commands were given,
+ *		so the output reads as if the commands ran one after another.
+ *
+ *		ASSIGNSU and ASSIGNBATCH need the size of the assigned lists over
+ *		all the shards, since the size limit is for all of them together.
+ *		Their parts meet at a barrier: the last one to arrive deals out the
+ *		users to assign round robin over the shards with users waiting, and
+ *		then each shard moves its own share.
+ *
+ * Assumptions: Every queue has the parts of the commands in the same
+ *		order, so the barrier of an ASSIGN is reached by all the shards
+ *		before any of them goes on to a later one.
+ *		The waiting queue is only in order within a shard: ASSIGNSU takes
+ *		the head of the shard whose turn it is, and PRINTWAITING prints the
+ *		shards one after another.  SAVE and LOAD are not available.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "datatypes.h"
+#include "list.h"
+#include "sas_support.h"
+#include "output.h"
+#include "shard.h"
+
+// what a command does in each shard, and how its parts are gathered
+enum { SHARD_TEXT, SHARD_CREATE, SHARD_ADD, SHARD_ADDTAIL, SHARD_REMOVE,
+    SHARD_LOOKUP, SHARD_MOVE, SHARD_CHANGE, SHARD_ASSIGN,
+    SHARD_PRINT_ASSIGNED, SHARD_PRINT_WAITING, SHARD_STATS, SHARD_PERF,
+    SHARD_SORT };
+
+struct shard_cmd_tag;
+
+// the work of one command in one shard, and what it found there
+typedef struct shard_part_tag {
+    struct shard_cmd_tag *cmd;
+    struct shard_part_tag *next;    // in the queue of the shard
+    int shard;
+    output_buf_t out;       // printed while the part ran
+    int created;            // 1 once the shard has its lists
+    int assigned;           // list sizes, with users still in the inbox
+    int waiting;
+    int count;              // users moved or changed
+    int quota;              // users an ASSIGN takes from this shard
+    su_info_t *rec;         // records to print, in list order
+    int rec_count;
+    list_perf_t perf[2];    // counters of the assigned list and the queue
+    int perf_kept;
+    double cpu_ms;          // SORT times of the shard
+    double wall_ms;
+} shard_part_t;
+
+// one command, from when it is given until its reply is written out
+typedef struct shard_cmd_tag {
+    int op;
+    int channel;            // the arguments of the command
+    int new_channel;
+    int su_id;
+    int size;
+    int count;
+    int batch;              // 1 for ASSIGNBATCH, 0 for ASSIGNSU
+    int sort_type;
+    int threads;
+    su_info_t rec;
+    shard_part_t *part;     // one for each shard the command goes to
+    int part_count;
+    int parts_left;         // parts not yet run, changed atomically
+    int arrived;            // parts at the barrier of an ASSIGN
+    int dealt;              // users an ASSIGN dealt out, and users left
+    int left;
+    output_buf_t out;       // SHARD_TEXT: printed by the dispatcher
+    struct shard_cmd_tag *next;     // in the order to write out
+} shard_cmd_t;
+
+// one shard: its lists and the worker thread that owns them
+typedef struct shard_tag {
+    ListPtr assigned;
+    ListPtr waiting;
+    pthread_t thread;
+    pthread_mutex_t lock;   // guards the queue, sleeping and stop
+    pthread_cond_t wake;
+    shard_part_t *head;     // parts to run, oldest first
+    shard_part_t *tail;
+    int sleeping;           // 1 while the worker waits for a part
+    int stop;
+    struct shard_set_tag *set;
+} shard_t;
+
+struct shard_set_tag {
+    shard_t shard[SHARD_MAX];
+    int count;
+    int assigned_mode;      // list_construct_mode flags of each list
+    int waiting_mode;
+    int index_channels;     // how sas_index_channels indexes the channels
+    int assign_next;        // the shard whose turn it is to assign next
+    shard_cmd_t *head;      // commands not yet written out, oldest first
+    shard_cmd_t *tail;
+    int pending;
+    pthread_mutex_t lock;   // guards the barrier and the wait for a command
+    pthread_cond_t done;    // the command the dispatcher waits on finished
+    pthread_cond_t barrier; // all the parts of an ASSIGN arrived
+    int waiting_done;       // 1 while the dispatcher waits on done
+    output_buf_t direct;    // printed by the dispatcher since the last command
+    output_buf_t reply;     // replies written out by shard_flush
+    output_buf_t *outer;    // the capture that shard_begin replaced
+};
+
+// Private functions used in this file only.
+void* ShardWorker(void *arg);
+void ShardRun(shard_t *S, shard_part_t *P);
+void ShardAssign(shard_t *S, shard_part_t *P);
+void ShardDeal(shard_set_t *set, shard_cmd_t *cmd);
+void ShardCollect(shard_part_t *P, ListPtr list_ptr, int channel);
+int ShardChannelSize(ListPtr list_ptr, int channel);
+shard_cmd_t *ShardCommand(shard_set_t *set, int op, int shard);
+int ShardOf(shard_set_t *set, int su_id);
+void ShardSubmit(shard_set_t *set, shard_cmd_t *cmd);
+void ShardSeal(shard_set_t *set);
+void ShardAppend(shard_set_t *set, shard_cmd_t *cmd);
+void ShardWait(shard_set_t *set, shard_cmd_t *cmd);
+void ShardWrite(shard_cmd_t *cmd);
+su_info_t *ShardGather(shard_cmd_t *cmd, int sorted, int *count);
+void ShardPerfAdd(list_perf_t *sum, const list_perf_t *perf);
+int ShardCompare(const void *a, const void *b);
+double ShardMs(const struct timespec *start, const struct timespec *end);
+void ShardFree(shard_cmd_t *cmd);
+
+/* Starts count shards, each with a worker thread waiting for commands.
+ * Their lists are made by the first CREATE, with the modes and channel
+ * index given here, as lab3 makes its lists.
+ *
+ * Returns the set of shards, or NULL if count is not 1 to SHARD_MAX.
+ */
+shard_set_t *shard_start(int count, int assigned_mode, int waiting_mode,
+        int index_channels)
+{
+    shard_set_t *set;
+    shard_t *S;
+    int i;
+
+    if (count < 1 || count > SHARD_MAX) {
+        return NULL;
+    }
+    set = (shard_set_t *) calloc(1, sizeof(shard_set_t));
+    set->count = count;
+    set->assigned_mode = assigned_mode;
+    set->waiting_mode = waiting_mode;
+    set->index_channels = index_channels;
+    pthread_mutex_init(&set->lock, NULL);
+    pthread_cond_init(&set->done, NULL);
+    pthread_cond_init(&set->barrier, NULL);
+    for (i = 0; i < count; i++) {
+        S = &set->shard[i];
+        S->set = set;
+        pthread_mutex_init(&S->lock, NULL);
+        pthread_cond_init(&S->wake, NULL);
+        pthread_create(&S->thread, NULL, ShardWorker, S);
+    }
+    return set;
+}
+
+/* Writes out every command not yet written, stops the workers and frees
+ * the shards with their lists.
+ */
+void shard_stop(shard_set_t *set)
+{
+    shard_t *S;
+    int i;
+
+    shard_flush(set, 1);
+    for (i = 0; i < set->count; i++) {
+        S = &set->shard[i];
+        pthread_mutex_lock(&S->lock);
+        S->stop = 1;
+        pthread_cond_signal(&S->wake);
+        pthread_mutex_unlock(&S->lock);
+        pthread_join(S->thread, NULL);
+        sas_cleanup(S->assigned);
+        sas_cleanup(S->waiting);
+        pthread_mutex_destroy(&S->lock);
+        pthread_cond_destroy(&S->wake);
+    }
+    pthread_mutex_destroy(&set->lock);
+    pthread_cond_destroy(&set->done);
+    pthread_cond_destroy(&set->barrier);
+    free(set->direct.text);
+    free(set->reply.text);
+    free(set);
+}
+
+/* Starts a run of commands.  What the dispatcher prints until shard_end,
+ * such as an error in a command, is kept in its place among the replies.
+ */
+void shard_begin(shard_set_t *set)
+{
+    set->outer = output_capture(&set->direct);
+}
+
+/* Ends a run of commands begun with shard_begin.
+ */
+void shard_end(shard_set_t *set)
+{
+    ShardSeal(set);
+    output_capture(set->outer);
+}
+
+/* Writes out the replies of the commands that are done, oldest first,
+ * stopping at the first that is not.
+ *
+ * wait: 1 to wait for every command given so far and then flush the
+ *       output buffer, as before waiting for more input.  Otherwise the
+ *       oldest commands are only waited for while more than
+ *       SHARD_PENDING_MAX are not written out.
+ */
+void shard_flush(shard_set_t *set, int wait)
+{
+    output_buf_t *outer;
+    shard_cmd_t *cmd;
+
+    // the replies are put together first, so the parts printed by the
+    // shards and the lines gathered from them all come out in one stream
+    outer = output_capture(&set->reply);
+    while ((cmd = set->head) != NULL) {
+        if (__atomic_load_n(&cmd->parts_left, __ATOMIC_ACQUIRE) > 0) {
+            if (!wait && set->pending <= SHARD_PENDING_MAX) {
+                break;
+            }
+            ShardWait(set, cmd);
+        }
+        set->head = cmd->next;
+        if (set->head == NULL) {
+            set->tail = NULL;
+        }
+        set->pending--;
+        ShardWrite(cmd);
+        ShardFree(cmd);
+    }
+    output_capture(outer);
+    output_buf(&set->reply);
+    set->reply.used = 0;
+    if (wait) {
+        output_flush();
+    }
+}
+
+/* CREATE: replaces the lists of every shard with new empty ones.  Only
+ * the first shard's messages are written, as they are the same for all.
+ */
+void shard_create(shard_set_t *set)
+{
+    ShardSubmit(set, ShardCommand(set, SHARD_CREATE, -1));
+}
+
+/* ADDSU: adds or updates the record in the shard of its user.
+ */
+void shard_add_rec(shard_set_t *set, const su_info_t *rec)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_ADD, ShardOf(set, rec->su_id));
+
+    cmd->rec = *rec;
+    ShardSubmit(set, cmd);
+}
+
+/* ADDTAIL: adds the user to the waiting queue of its shard.
+ */
+void shard_addtail(shard_set_t *set, int su_id)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_ADDTAIL, ShardOf(set, su_id));
+
+    cmd->su_id = su_id;
+    ShardSubmit(set, cmd);
+}
+
+/* DELSU: removes the user from its shard.
+ */
+void shard_remove(shard_set_t *set, int su_id)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_REMOVE, ShardOf(set, su_id));
+
+    cmd->su_id = su_id;
+    ShardSubmit(set, cmd);
+}
+
+/* LISTCH: prints the users on the channel from every shard, by su_id.
+ */
+void shard_lookup(shard_set_t *set, int channel)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_LOOKUP, -1);
+
+    cmd->channel = channel;
+    ShardSubmit(set, cmd);
+}
+
+/* CLEARCH: moves the users on the channel to the waiting queue of their
+ * shard, and prints the count over all the shards.
+ */
+void shard_move(shard_set_t *set, int channel)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_MOVE, -1);
+
+    cmd->channel = channel;
+    ShardSubmit(set, cmd);
+}
+
+/* CHANGECH: changes the channel of the users on old_channel in every
+ * shard, and prints the count over all the shards.
+ */
+void shard_change(shard_set_t *set, int old_channel, int new_channel)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_CHANGE, -1);
+
+    cmd->channel = old_channel;
+    cmd->new_channel = new_channel;
+    ShardSubmit(set, cmd);
+}
+
+/* ASSIGNSU: assigns a waiting user to the channel unless the assigned
+ * lists of all the shards together hold size users.
+ */
+void shard_assign(shard_set_t *set, int size, int channel)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_ASSIGN, -1);
+
+    cmd->size = size;
+    cmd->channel = channel;
+    cmd->count = 1;
+    ShardSubmit(set, cmd);
+}
+
+/* ASSIGNBATCH: assigns up to count waiting users to the channel, as long
+ * as the assigned lists of all the shards together hold fewer than size.
+ */
+void shard_assign_batch(shard_set_t *set, int size, int channel, int count)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_ASSIGN, -1);
+
+    cmd->size = size;
+    cmd->channel = channel;
+    cmd->count = count;
+    cmd->batch = 1;
+    ShardSubmit(set, cmd);
+}
+
+/* PRINTASSIGNED and PRINTWAITING: prints the assigned lists of every
+ * shard merged by su_id, or the waiting queues one shard after another.
+ */
+void shard_print(shard_set_t *set, int waiting)
+{
+    ShardSubmit(set, ShardCommand(set,
+                waiting ? SHARD_PRINT_WAITING : SHARD_PRINT_ASSIGNED, -1));
+}
+
+/* STATS: prints the list sizes added up over the shards.
+ */
+void shard_stats(shard_set_t *set, int size)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_STATS, -1);
+
+    cmd->size = size;
+    ShardSubmit(set, cmd);
+}
+
+/* PERF: prints the counters of the lists added up over the shards, and
+ * sets them back to zero.
+ */
+void shard_perf(shard_set_t *set)
+{
+    ShardSubmit(set, ShardCommand(set, SHARD_PERF, -1));
+}
+
+/* SORT: sorts the waiting queue of every shard at once.  The line printed
+ * has the size of all the queues, the CPU time of the shard threads added
+ * up, and the wall clock time of the slowest shard.
+ */
+void shard_sort(shard_set_t *set, int sort_type, int threads)
+{
+    shard_cmd_t *cmd = ShardCommand(set, SHARD_SORT, -1);
+
+    cmd->sort_type = sort_type;
+    cmd->threads = threads;
+    ShardSubmit(set, cmd);
+}
+
+/*** Private Functions ***/
+
+/* Worker thread of a shard: takes all the parts in its queue at once and
+ * runs them in order, until told to stop with the queue empty.
+ */
+void* ShardWorker(void *arg) {
+    shard_t *S = (shard_t *) arg;
+    shard_part_t *P, *next;
+
+    pthread_mutex_lock(&S->lock);
+    for (;;) {
+        while (S->head == NULL && !S->stop) {
+            S->sleeping = 1;
+            pthread_cond_wait(&S->wake, &S->lock);
+            S->sleeping = 0;
+        }
+        if (S->head == NULL) {
+            break;
+        }
+        P = S->head;
+        S->head = S->tail = NULL;
+        pthread_mutex_unlock(&S->lock);
+        while (P != NULL) {
+            next = P->next; // the part may be freed once it is done
+            ShardRun(S, P);
+            P = next;
+        }
+        pthread_mutex_lock(&S->lock);
+    }
+    pthread_mutex_unlock(&S->lock);
+    return NULL;
+}
+
+/* Runs one part on the lists of the shard, with its output captured, and
+ * wakes the dispatcher if it waits for the command and this was its last
+ * part.
+ */
+void ShardRun(shard_t *S, shard_part_t *P) {
+    shard_set_t *set = S->set;
+    shard_cmd_t *cmd = P->cmd;
+    struct timespec cpu_start, cpu_end, wall_start, wall_end;
+
+    output_capture(&P->out);
+    P->created = (S->assigned != NULL);
+    switch (cmd->op) {
+    case SHARD_CREATE:
+        S->assigned = sas_create(S->assigned, "assignment list", S->waiting,
+                set->assigned_mode);
+        sas_index_channels(S->assigned, set->index_channels);
+        S->waiting = sas_create(S->waiting, "waiting queue", S->assigned,
+                set->waiting_mode);
+        break;
+    case SHARD_ADD:
+        // the size limit is kept over all the shards, by SHARD_ASSIGN
+        sas_add_rec(S->assigned, INT_MAX, S->waiting, &cmd->rec);
+        break;
+    case SHARD_ADDTAIL:
+        sas_addtail(S->waiting, cmd->su_id);
+        break;
+    case SHARD_REMOVE:
+        sas_remove(S->assigned, S->waiting, cmd->su_id);
+        break;
+    case SHARD_LOOKUP:
+        if (P->created) {
+            P->assigned = list_size(S->assigned);
+            ShardCollect(P, S->assigned, cmd->channel);
+        }
+        break;
+    case SHARD_MOVE:
+        // the users moved are counted by the growth of the queue
+        if (P->created) {
+            P->count = -list_size(S->waiting) - list_pending(S->waiting);
+            sas_move(S->assigned, cmd->channel, S->waiting);
+            P->count += list_size(S->waiting) + list_pending(S->waiting);
+        }
+        break;
+    case SHARD_CHANGE:
+        if (P->created) {
+            P->count = ShardChannelSize(S->assigned, cmd->channel);
+            sas_change(S->assigned, cmd->channel, cmd->new_channel);
+        }
+        break;
+    case SHARD_ASSIGN:
+        ShardAssign(S, P);
+        break;
+    case SHARD_PRINT_ASSIGNED:
+        if (P->created) {
+            ShardCollect(P, S->assigned, -1);
+        }
+        break;
+    case SHARD_PRINT_WAITING:
+        if (P->created) {
+            // ShardCollect takes the read lock, so the write lock is
+            // given back first
+            list_lock(S->waiting, LIST_WRITE);
+            list_drain(S->waiting);
+            list_unlock(S->waiting);
+            ShardCollect(P, S->waiting, -1);
+        }
+        break;
+    case SHARD_STATS:
+        if (P->created) {
+            P->assigned = list_size(S->assigned);
+            P->waiting = list_size(S->waiting) + list_pending(S->waiting);
+        }
+        break;
+    case SHARD_PERF:
+        if (P->created) {
+            P->perf_kept = list_perf_read(S->assigned, &P->perf[0]);
+            list_perf_read(S->waiting, &P->perf[1]);
+            list_perf_reset(S->assigned);
+            list_perf_reset(S->waiting);
+        }
+        break;
+    case SHARD_SORT:
+        // the line sas_sort prints is not written, the times are gathered
+        if (P->created) {
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+            clock_gettime(CLOCK_MONOTONIC, &wall_start);
+            sas_sort(S->waiting, cmd->sort_type, cmd->threads);
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+            clock_gettime(CLOCK_MONOTONIC, &wall_end);
+            P->waiting = list_size(S->waiting);
+            P->cpu_ms = ShardMs(&cpu_start, &cpu_end);
+            P->wall_ms = ShardMs(&wall_start, &wall_end);
+        }
+        break;
+    }
+    output_capture(NULL);
+
+    // the dispatcher sets waiting_done before it looks at parts_left
+    if (__atomic_sub_fetch(&cmd->parts_left, 1, __ATOMIC_SEQ_CST) == 0
+            && __atomic_load_n(&set->waiting_done, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&set->lock);
+        pthread_cond_broadcast(&set->done);
+        pthread_mutex_unlock(&set->lock);
+    }
+}
+
+/* The part of an ASSIGN in one shard.  It gives the sizes of its lists and
+ * waits at the barrier until every shard has; the last to arrive deals out
+ * the users to assign.  Then the shard moves its share from the head of
+ * its waiting queue.
+ */
+void ShardAssign(shard_t *S, shard_part_t *P) {
+    shard_set_t *set = S->set;
+    shard_cmd_t *cmd = P->cmd;
+
+    if (P->created) {
+        P->assigned = list_size(S->assigned);
+        P->waiting = list_size(S->waiting) + list_pending(S->waiting);
+    }
+    pthread_mutex_lock(&set->lock);
+    if (++cmd->arrived == cmd->part_count) {
+        ShardDeal(set, cmd);
+        pthread_cond_broadcast(&set->barrier);
+    }
+    while (cmd->arrived < cmd->part_count) {
+        pthread_cond_wait(&set->barrier, &set->lock);
+    }
+    pthread_mutex_unlock(&set->lock);
+
+    // the quota already fits under the size limit of all the shards.  One
+    // user goes in through the skip list; list_merge_sorted walks the list
+    if (P->quota == 1) {
+        sas_assign(S->assigned, INT_MAX, S->waiting, cmd->channel);
+    }
+    else if (P->quota > 1) {
+        sas_assign_batch(S->assigned, INT_MAX, S->waiting, cmd->channel, P->quota);
+    }
+}
+
+/* Deals out the users an ASSIGN can take, by the rules of sas_assign and
+ * sas_assign_batch over the lists of all the shards: ASSIGNSU takes one
+ * user unless none are waiting or exactly size are assigned, and
+ * ASSIGNBATCH takes up to its count, as many as fit under the size limit,
+ * and no more than are waiting.  They are dealt one
+ * at a time to the shards in turn, starting where the last ASSIGN left
+ * off and skipping shards that have no more users waiting.
+ *
+ * Called by the last part at the barrier, with set->lock held.
+ */
+void ShardDeal(shard_set_t *set, shard_cmd_t *cmd) {
+    int assigned = 0, waiting = 0;
+    int batch, dealt, i;
+
+    if (!cmd->part[0].created) {
+        return;
+    }
+    for (i = 0; i < cmd->part_count; i++) {
+        assigned += cmd->part[i].assigned;
+        waiting += cmd->part[i].waiting;
+    }
+    if (!cmd->batch) {
+        batch = (waiting > 0 && assigned != cmd->size);
+    }
+    else {
+        batch = cmd->count;
+        if (batch > cmd->size - assigned) {
+            batch = cmd->size - assigned;
+        }
+        if (batch > waiting) {
+            batch = waiting;
+        }
+    }
+    for (dealt = 0, i = set->assign_next; dealt < batch; i = (i + 1) % set->count) {
+        if (cmd->part[i].quota < cmd->part[i].waiting) {
+            cmd->part[i].quota++;
+            dealt++;
+        }
+    }
+    set->assign_next = i;
+    cmd->dealt = dealt;
+    cmd->left = waiting - dealt;
+}
+
+/* Copies the records of a list, or those on channel when it is not -1,
+ * into the part, in list order.
+ */
+void ShardCollect(shard_part_t *P, ListPtr list_ptr, int channel) {
+    IteratorPtr rover;
+    su_info_t *rec_ptr;
+    int n = 0;
+
+    list_lock(list_ptr, LIST_READ);
+    P->rec = (su_info_t *) malloc((list_size(list_ptr) + 1) * sizeof(su_info_t));
+    if (channel >= 0 && list_group_count(list_ptr) > channel) {
+        // the channel index visits only the users on the channel
+        rover = list_group_front(list_ptr, channel);
+        while (rover != NULL) {
+            P->rec[n++] = *list_access(list_ptr, rover);
+            rover = list_group_next(list_ptr, rover);
+        }
+    }
+    else {
+        rover = list_iter_front(list_ptr);
+        while (rover != NULL) {
+            rec_ptr = list_access(list_ptr, rover);
+            if (channel < 0 || rec_ptr->channel == channel) {
+                P->rec[n++] = *rec_ptr;
+            }
+            rover = list_iter_next(rover);
+        }
+    }
+    list_unlock(list_ptr);
+    P->rec_count = n;
+}
+
+/* Returns the number of users on channel in the assigned list.
+ */
+int ShardChannelSize(ListPtr list_ptr, int channel) {
+    IteratorPtr rover;
+    int n = 0;
+
+    list_lock(list_ptr, LIST_READ);
+    if (list_group_count(list_ptr) > channel) {
+        n = list_group_size(list_ptr, channel);
+    }
+    else {
+        for (rover = list_iter_front(list_ptr); rover != NULL;
+                rover = list_iter_next(rover)) {
+            n += (list_access(list_ptr, rover)->channel == channel);
+        }
+    }
+    list_unlock(list_ptr);
+    return n;
+}
+
+/* Makes a command with a part for one shard, or for every shard if shard
+ * is -1.
+ */
+shard_cmd_t *ShardCommand(shard_set_t *set, int op, int shard) {
+    shard_cmd_t *cmd = (shard_cmd_t *) calloc(1, sizeof(shard_cmd_t));
+    int i;
+
+    cmd->op = op;
+    cmd->part_count = (shard == -1) ? set->count : 1;
+    cmd->parts_left = cmd->part_count;
+    cmd->part = (shard_part_t *) calloc(cmd->part_count, sizeof(shard_part_t));
+    for (i = 0; i < cmd->part_count; i++) {
+        cmd->part[i].cmd = cmd;
+        cmd->part[i].shard = (shard == -1) ? i : shard;
+    }
+    return cmd;
+}
+
+/* Returns the shard of a user.  The hash index of a list takes the top
+ * bits of a Fibonacci hash, so the shard comes from a different hash (the
+ * finalizer of MurmurHash3), or all the users of a shard would share a few
+ * buckets.  The multiply by the count maps the hash onto the shards.
+ */
+int ShardOf(shard_set_t *set, int su_id) {
+    unsigned int hash = (unsigned int) su_id;
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return (int) (((unsigned long) hash * set->count) >> 32);
+}
+
+/* Puts the command in line to be written out, after what the dispatcher
+ * printed before it, and adds its parts to the queues of their shards.
+ */
+void ShardSubmit(shard_set_t *set, shard_cmd_t *cmd) {
+    shard_part_t *P;
+    shard_t *S;
+    int i;
+
+    ShardSeal(set);
+    ShardAppend(set, cmd);
+    for (i = 0; i < cmd->part_count; i++) {
+        P = &cmd->part[i];
+        S = &set->shard[P->shard];
+        pthread_mutex_lock(&S->lock);
+        if (S->tail != NULL) {
+            S->tail->next = P;
+        }
+        else {
+            S->head = P;
+        }
+        S->tail = P;
+        if (S->sleeping) {
+            pthread_cond_signal(&S->wake);
+        }
+        pthread_mutex_unlock(&S->lock);
+    }
+}
+
+/* Puts what the dispatcher printed since the last command in line to be
+ * written out, as a command that is already done.
+ */
+void ShardSeal(shard_set_t *set) {
+    shard_cmd_t *cmd;
+
+    if (set->direct.used == 0) {
+        return;
+    }
+    cmd = (shard_cmd_t *) calloc(1, sizeof(shard_cmd_t));
+    cmd->op = SHARD_TEXT;
+    cmd->out = set->direct;
+    memset(&set->direct, 0, sizeof(output_buf_t));
+    ShardAppend(set, cmd);
+}
+
+/* Adds the command to the end of the commands to write out.
+ */
+void ShardAppend(shard_set_t *set, shard_cmd_t *cmd) {
+    if (set->tail != NULL) {
+        set->tail->next = cmd;
+    }
+    else {
+        set->head = cmd;
+    }
+    set->tail = cmd;
+    set->pending++;
+}
+
+/* Waits until every part of the command has run.
+ */
+void ShardWait(shard_set_t *set, shard_cmd_t *cmd) {
+    pthread_mutex_lock(&set->lock);
+    __atomic_store_n(&set->waiting_done, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&cmd->parts_left, __ATOMIC_SEQ_CST) > 0) {
+        pthread_cond_wait(&set->done, &set->lock);
+    }
+    __atomic_store_n(&set->waiting_done, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&set->lock);
+}
+
+/* Writes out the reply of a command that is done, from the output of its
+ * parts or from the results gathered from them.
+ */
+void ShardWrite(shard_cmd_t *cmd) {
+    shard_part_t *P = cmd->part;
+    list_perf_t perf[2];
+    su_info_t *rec;
+    int assigned = 0, waiting = 0, count = 0;
+    double cpu_ms = 0, wall_ms = 0;
+    int i;
+
+    if (cmd->op == SHARD_TEXT) {
+        output_buf(&cmd->out);
+        return;
+    }
+    if (cmd->op == SHARD_CREATE || cmd->op == SHARD_ADD
+            || cmd->op == SHARD_ADDTAIL || cmd->op == SHARD_REMOVE) {
+        output_buf(&P[0].out);
+        return;
+    }
+    if (!P[0].created) {
+        return; // as the sas_support.c functions do with no lists
+    }
+    for (i = 0; i < cmd->part_count; i++) {
+        assigned += P[i].assigned;
+        waiting += P[i].waiting;
+        count += P[i].count;
+        cpu_ms += P[i].cpu_ms;
+        wall_ms = (P[i].wall_ms > wall_ms) ? P[i].wall_ms : wall_ms;
+    }
+
+    switch (cmd->op) {
+    case SHARD_LOOKUP:
+        rec = ShardGather(cmd, 1, &count);
+        sas_lookup_array(rec, count, assigned, cmd->channel);
+        free(rec);
+        break;
+    case SHARD_MOVE:
+        if (count == 0) {
+            output_printf("Did not find any users on channel %d\n", cmd->channel);
+        } else {
+            output_printf("Removed %d from channel %d\n", count, cmd->channel);
+        }
+        break;
+    case SHARD_CHANGE:
+        if (count == 0) {
+            output_printf("Did not find any users on channel %d\n", cmd->channel);
+        } else {
+            output_printf("Moved %d users from channel %d to %d\n", count,
+                    cmd->channel, cmd->new_channel);
+        }
+        break;
+    case SHARD_ASSIGN:
+        for (i = 0; i < cmd->part_count; i++) {
+            output_buf(&P[i].out);
+        }
+        if (cmd->dealt < cmd->count) {
+            if (cmd->left == 0) {
+                output_printf("No secondary users are waiting\n");
+            } else {
+                output_printf("User(s) waiting but the assigned list is full %d\n",
+                        cmd->size);
+            }
+        }
+        break;
+    case SHARD_PRINT_ASSIGNED:
+    case SHARD_PRINT_WAITING:
+        rec = ShardGather(cmd, cmd->op == SHARD_PRINT_ASSIGNED, &count);
+        sas_print_array(rec, count, (cmd->op == SHARD_PRINT_ASSIGNED)
+                ? "Assigned List" : "Waiting Queue");
+        free(rec);
+        break;
+    case SHARD_STATS:
+        output_printf("List records:  %d, Max list size: %d  ", assigned, cmd->size);
+        output_printf("Queue records: %d\n", waiting);
+        break;
+    case SHARD_PERF:
+        memset(perf, 0, sizeof(perf));
+        for (i = 0; i < cmd->part_count; i++) {
+            ShardPerfAdd(&perf[0], &P[i].perf[0]);
+            ShardPerfAdd(&perf[1], &P[i].perf[1]);
+        }
+        sas_perf_print(&perf[0], P[0].perf_kept, "Assigned List");
+        sas_perf_print(&perf[1], P[0].perf_kept, "Waiting Queue");
+        break;
+    case SHARD_SORT:
+        output_printf("%d\t%f\t%d\t%f\n", waiting, cpu_ms, cmd->sort_type, wall_ms);
+        break;
+    }
+}
+
+/* Returns the records of all the parts in one array, and their number in
+ * *count.  sorted: 1 to order them by su_id, or 0 to keep them shard by
+ * shard.
+ */
+su_info_t *ShardGather(shard_cmd_t *cmd, int sorted, int *count) {
+    su_info_t *rec;
+    int n = 0, i;
+
+    for (i = 0; i < cmd->part_count; i++) {
+        n += cmd->part[i].rec_count;
+    }
+    rec = (su_info_t *) malloc((n + 1) * sizeof(su_info_t));
+    for (n = 0, i = 0; i < cmd->part_count; i++) {
+        memcpy(rec + n, cmd->part[i].rec, cmd->part[i].rec_count * sizeof(su_info_t));
+        n += cmd->part[i].rec_count;
+    }
+    if (sorted && cmd->part_count > 1) {
+        qsort(rec, n, sizeof(su_info_t), ShardCompare);
+    }
+    *count = n;
+    return rec;
+}
+
+/* Adds the counters of perf to sum.
+ */
+void ShardPerfAdd(list_perf_t *sum, const list_perf_t *perf) {
+    int i;
+
+    sum->comparisons += perf->comparisons;
+    sum->find_visits += perf->find_visits;
+    sum->insert_visits += perf->insert_visits;
+    sum->mallocs += perf->mallocs;
+    sum->frees += perf->frees;
+    sum->pool_allocs += perf->pool_allocs;
+    sum->pool_frees += perf->pool_frees;
+    for (i = 0; i <= LIST_SORT_TYPES; i++) {
+        sum->sorts[i] += perf->sorts[i];
+    }
+}
+
+/* qsort comparison for records, smallest su_id first, as the assigned list
+ * is kept.
+ */
+int ShardCompare(const void *a, const void *b) {
+    int id_a = ((const su_info_t *) a)->su_id;
+    int id_b = ((const su_info_t *) b)->su_id;
+
+    return (id_a > id_b) - (id_a < id_b);
+}
+
+/* Milliseconds from start to end.
+ */
+double ShardMs(const struct timespec *start, const struct timespec *end) {
+    return 1000.0 * (end->tv_sec - start->tv_sec)
+        + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* Frees a command that was written out, with its parts.
+ */
+void ShardFree(shard_cmd_t *cmd) {
+    int i;
+
+    for (i = 0; i < cmd->part_count; i++) {
+        free(cmd->part[i].out.text);
+        free(cmd->part[i].rec);
+    }
+    free(cmd->part);
+    free(cmd->out.text);
+    free(cmd);
+}
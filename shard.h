@@ -0,0 +1,44 @@
+/* shard.h
+ * MP3
+ *
+ * Purpose: Public functions for running the SAS commands on lists split
+ * into shards by su_id, each shard with its own worker thread.
+ *
+ * Assumptions: One thread, the dispatcher, calls these functions, and the
+ * output of the commands comes out in the order they were given, when
+ * shard_flush writes it.  The commands are given between shard_begin and
+ * shard_end, and shard_flush is called outside of them.
+ *
+ * Bugs:
+ */
+
+// most shards
+#define SHARD_MAX 64
+
+// commands waiting to be written out past which shard_flush waits for the
+// oldest one even when not asked to
+#define SHARD_PENDING_MAX 4096
+
+typedef struct shard_set_tag shard_set_t;
+
+shard_set_t *shard_start(int count, int assigned_mode, int waiting_mode,
+        int index_channels);
+void shard_stop(shard_set_t *set);
+void shard_begin(shard_set_t *set);
+void shard_end(shard_set_t *set);
+void shard_flush(shard_set_t *set, int wait);
+
+// the SAS commands, with the arguments of the sas_support.c function
+void shard_create(shard_set_t *set);
+void shard_add_rec(shard_set_t *set, const su_info_t *rec);
+void shard_addtail(shard_set_t *set, int su_id);
+void shard_remove(shard_set_t *set, int su_id);
+void shard_lookup(shard_set_t *set, int channel);
+void shard_move(shard_set_t *set, int channel);
+void shard_change(shard_set_t *set, int old_channel, int new_channel);
+void shard_assign(shard_set_t *set, int size, int channel);
+void shard_assign_batch(shard_set_t *set, int size, int channel, int count);
+void shard_print(shard_set_t *set, int waiting);
+void shard_stats(shard_set_t *set, int size);
+void shard_perf(shard_set_t *set);
+void shard_sort(shard_set_t *set, int sort_type, int threads);
@@ -0,0 +1,24 @@
+/* su_list.h
+ * MP3
+ *
+ * Purpose: The list of su_info_t records from typed_list.h, with the
+ *		comparison of sas_compare inlined.  It orders records as a list.h
+ *		list built with sas_compare does, so the two can be benchmarked
+ *		against each other (see typedbench.c).
+ *
+ * Assumptions: datatypes.h is included first.
+ *
+ * Bugs:
+ */
+
+#include "typed_list.h"
+
+/* Returns 1 if rec_a has the smaller ID, -1 if rec_b does and 0 if they
+ * are equal, exactly like sas_compare.
+ */
+static inline int su_list_compare(const su_info_t *rec_a, const su_info_t *rec_b)
+{
+    return (rec_a->su_id < rec_b->su_id) - (rec_a->su_id > rec_b->su_id);
+}
+
+TYPED_LIST_DEFINE(su_list, su_info_t, su_list_compare)
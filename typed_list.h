@@ -0,0 +1,205 @@
+/* typed_list.h
+ * MP3
+ *
+ * Purpose: A two way linked list specialized at compile time for one record
+ *		type and one comparison.  TYPED_LIST_DEFINE(prefix, type, comp) emits
+ *		the types prefix_t and prefix_node_t and static inline functions
+ *		prefix_construct, prefix_destruct, prefix_insert_tail,
+ *		prefix_insert_sorted, prefix_find, prefix_remove, prefix_sort and the
+ *		iterator functions, all working on records of that type.
+ *
+ *		comp(a, b) takes two const type pointers and returns 1 if a goes
+ *		closer to the head than b, -1 if b does, and 0 if they are equal,
+ *		like the comp_proc of list.h.  It is called directly, not through a
+ *		pointer, so a static inline comp is inlined into the scan and merge
+ *		loops.
+ *
+ * Assumptions: Each record is stored inline in its node, one malloc per
+ *		node.  There is no pool, hash, skip or group index: this is the core
+ *		of list.c without its options, for code that wants the comparison
+ *		inlined.  The sort is the bottom-up merge sort of sort type 6, and
+ *		is stable.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+// pending runs of prefix_sort, one per doubling of the run length
+#define TYPED_LIST_BINS 32
+
+#define TYPED_LIST_DEFINE(prefix, type, comp)                                  \
+                                                                               \
+typedef struct prefix##_node_tag {                                             \
+    type data;                                                                 \
+    struct prefix##_node_tag *prev;                                            \
+    struct prefix##_node_tag *next;                                            \
+} prefix##_node_t;                                                             \
+                                                                               \
+typedef struct prefix##_tag {                                                  \
+    prefix##_node_t *head;                                                     \
+    prefix##_node_t *tail;                                                     \
+    int size;                                                                  \
+    int sorted;         /* 0 once an insert at the tail breaks the order */    \
+} prefix##_t;                                                                  \
+                                                                               \
+/* Allocates a new, empty list, which counts as sorted. */                     \
+static inline prefix##_t * prefix##_construct(void)                            \
+{                                                                              \
+    prefix##_t *L = (prefix##_t *) malloc(sizeof(prefix##_t));                \
+    L->head = NULL;                                                            \
+    L->tail = NULL;                                                            \
+    L->size = 0;                                                               \
+    L->sorted = 1;                                                             \
+    return L;                                                                  \
+}                                                                              \
+                                                                               \
+/* Frees every node and the header. */                                         \
+static inline void prefix##_destruct(prefix##_t *L)                            \
+{                                                                              \
+    prefix##_node_t *N = L->head;                                              \
+    prefix##_node_t *next;                                                     \
+    while (N != NULL) {                                                        \
+        next = N->next;                                                        \
+        free(N);                                                               \
+        N = next;                                                              \
+    }                                                                          \
+    free(L);                                                                   \
+}                                                                              \
+                                                                               \
+static inline int prefix##_size(prefix##_t *L) { return L->size; }             \
+static inline int prefix##_is_sorted(prefix##_t *L) { return L->sorted; }      \
+static inline prefix##_node_t * prefix##_front(prefix##_t *L)                  \
+{                                                                              \
+    return L->head;                                                            \
+}                                                                              \
+static inline prefix##_node_t * prefix##_next(prefix##_node_t *N)              \
+{                                                                              \
+    return N->next;                                                            \
+}                                                                              \
+static inline type * prefix##_access(prefix##_node_t *N)                       \
+{                                                                              \
+    return &N->data;                                                           \
+}                                                                              \
+                                                                               \
+/* Links N into L before the node at, or at the tail if at is NULL. */         \
+static inline void prefix##_link(prefix##_t *L, prefix##_node_t *N,            \
+        prefix##_node_t *at)                                                   \
+{                                                                              \
+    N->next = at;                                                              \
+    N->prev = (at == NULL) ? L->tail : at->prev;                               \
+    if (N->prev == NULL) L->head = N; else N->prev->next = N;                  \
+    if (at == NULL) L->tail = N; else at->prev = N;                            \
+    L->size++;                                                                 \
+}                                                                              \
+                                                                               \
+/* Copies *elem_ptr into a new node at the tail.  Returns the node. */         \
+static inline prefix##_node_t * prefix##_insert_tail(prefix##_t *L,            \
+        const type *elem_ptr)                                                  \
+{                                                                              \
+    prefix##_node_t *N = (prefix##_node_t *) malloc(sizeof(prefix##_node_t));  \
+    N->data = *elem_ptr;                                                       \
+    if (L->tail != NULL && comp(&L->tail->data, elem_ptr) == -1) {             \
+        L->sorted = 0;                                                         \
+    }                                                                          \
+    prefix##_link(L, N, NULL);                                                 \
+    return N;                                                                  \
+}                                                                              \
+                                                                               \
+/* Copies *elem_ptr into a new node after any equal records of a sorted        \
+ * list.  Returns the node. */                                                 \
+static inline prefix##_node_t * prefix##_insert_sorted(prefix##_t *L,          \
+        const type *elem_ptr)                                                  \
+{                                                                              \
+    prefix##_node_t *N = (prefix##_node_t *) malloc(sizeof(prefix##_node_t));  \
+    prefix##_node_t *at = L->head;                                             \
+    assert(L->sorted);                                                         \
+    N->data = *elem_ptr;                                                       \
+    while (at != NULL && comp(elem_ptr, &at->data) != 1) {                     \
+        at = at->next;                                                         \
+    }                                                                          \
+    prefix##_link(L, N, at);                                                   \
+    return N;                                                                  \
+}                                                                              \
+                                                                               \
+/* Returns the first node equal to *elem_ptr, or NULL.  A sorted list is       \
+ * only scanned up to where the record would be. */                            \
+static inline prefix##_node_t * prefix##_find(prefix##_t *L,                   \
+        const type *elem_ptr)                                                  \
+{                                                                              \
+    prefix##_node_t *N;                                                        \
+    int result;                                                                \
+    for (N = L->head; N != NULL; N = N->next) {                                \
+        result = comp(&N->data, elem_ptr);                                     \
+        if (result == 0) return N;                                             \
+        if (result == -1 && L->sorted) return NULL;                            \
+    }                                                                          \
+    return NULL;                                                               \
+}                                                                              \
+                                                                               \
+/* Unlinks and frees N, copying its record to *elem_ptr unless that is         \
+ * NULL. */                                                                    \
+static inline void prefix##_remove(prefix##_t *L, prefix##_node_t *N,          \
+        type *elem_ptr)                                                        \
+{                                                                              \
+    if (N->prev == NULL) L->head = N->next; else N->prev->next = N->next;      \
+    if (N->next == NULL) L->tail = N->prev; else N->next->prev = N->prev;      \
+    L->size--;                                                                 \
+    if (L->size == 0) L->sorted = 1;                                           \
+    if (elem_ptr != NULL) *elem_ptr = N->data;                                 \
+    free(N);                                                                   \
+}                                                                              \
+                                                                               \
+/* Merges chain a followed by chain b, ties going to a. */                     \
+static inline prefix##_node_t * prefix##_merge_chains(prefix##_node_t *a,      \
+        prefix##_node_t *b)                                                    \
+{                                                                              \
+    prefix##_node_t *head = NULL;                                              \
+    prefix##_node_t **link = &head;                                            \
+    while (a != NULL && b != NULL) {                                           \
+        if (comp(&b->data, &a->data) == 1) {                                   \
+            *link = b;                                                         \
+            b = b->next;                                                       \
+        }                                                                      \
+        else {                                                                 \
+            *link = a;                                                         \
+            a = a->next;                                                       \
+        }                                                                      \
+        link = &(*link)->next;                                                 \
+    }                                                                          \
+    *link = (a != NULL) ? a : b;                                               \
+    return head;                                                               \
+}                                                                              \
+                                                                               \
+/* Sorts the list with a stable bottom-up merge sort that relinks the          \
+ * nodes, allocating nothing: bin[i] holds a sorted run of 2^i nodes. */       \
+static inline void prefix##_sort(prefix##_t *L)                                \
+{                                                                              \
+    prefix##_node_t *bin[TYPED_LIST_BINS];                                     \
+    prefix##_node_t *N = L->head;                                              \
+    prefix##_node_t *next, *prev;                                              \
+    int i;                                                                     \
+    memset(bin, 0, sizeof(bin));                                               \
+    while (N != NULL) {                                                        \
+        next = N->next;                                                        \
+        N->next = NULL;                                                        \
+        for (i = 0; i < TYPED_LIST_BINS - 1 && bin[i] != NULL; i++) {          \
+            N = prefix##_merge_chains(bin[i], N);                              \
+            bin[i] = NULL;                                                     \
+        }                                                                      \
+        bin[i] = (bin[i] == NULL) ? N : prefix##_merge_chains(bin[i], N);      \
+        N = next;                                                              \
+    }                                                                          \
+    N = NULL;                                                                  \
+    for (i = 0; i < TYPED_LIST_BINS; i++) {                                    \
+        if (bin[i] != NULL) N = prefix##_merge_chains(bin[i], N);              \
+    }                                                                          \
+    L->head = N;                                                               \
+    for (prev = NULL; N != NULL; prev = N, N = N->next) {                      \
+        N->prev = prev;                                                        \
+    }                                                                          \
+    L->tail = prev;                                                            \
+    L->sorted = 1;                                                             \
+}
@@ -0,0 +1,235 @@
+/* typedbench.c
+ * MP3
+ *
+ * Purpose: Benchmarks the su_list of typed_list.h, whose comparison is
+ *		inlined, against a list.h list that calls sas_compare through its
+ *		comp_proc pointer.  Both use one malloc per node with the record
+ *		inline, so the comparison call is the main difference.  Three tests
+ *		are timed for each size:
+ *		    sort:   list_sort type 6 against su_list_sort, the same
+ *		            bottom-up merge sort
+ *		    insert: list_insert_sorted against su_list_insert_sorted for
+ *		            every key, into a list that starts empty
+ *		    find:   list_elem_find against su_list_find for every key of
+ *		            the sorted list, scanning from the head
+ *		The median of the runs is written as CSV on stdout.
+ *
+ *		Usage: ./typedbench [-n sizes] [-r reps] [-q max] [-p pattern]
+ *
+ *		-n: comma separated sizes, by default 1000,10000,100000,1000000
+ *		-r: timed runs of each test, by default 5
+ *		-q: largest list for the quadratic insert and find tests, by
+ *		    default 16000
+ *		-p: key pattern (see pattern.c), by default 1 (random)
+ *
+ * Assumptions: The lists are built outside the timed part, from the same
+ *		keys for both implementations.
+ *
+ * Bugs: None known.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "datatypes.h"
+#include "list.h"
+#include "sas_support.h"
+#include "pattern.h"
+#include "su_list.h"
+
+// most sizes on the command line
+#define BENCH_MAX_SIZES 16
+
+// the tests, each run on both lists
+#define BENCH_SORT   0
+#define BENCH_INSERT 1
+#define BENCH_FIND   2
+
+// Private functions used in this file only.
+double BenchList(const int *keys, int size, int test);
+double BenchTyped(const int *keys, int size, int test);
+double BenchMs(const struct timespec *start, const struct timespec *end);
+int BenchCompareTime(const void *a, const void *b);
+
+int main(int argc, char *argv[])
+{
+    static const char *test_name[] = { "sort", "insert", "find" };
+    int sizes[BENCH_MAX_SIZES] = { 1000, 10000, 100000, 1000000 };
+    int size_count = 4, reps = 5, quadratic_max = 16000;
+    int pattern = PATTERN_RANDOM;
+    double list_time[64], typed_time[64];
+    char *text, *end;
+    int *keys;
+    int test, n, r, i;
+
+    for (i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-n") == 0) {
+            text = argv[i + 1];
+            for (size_count = 0; size_count < BENCH_MAX_SIZES; ) {
+                sizes[size_count++] = (int) strtol(text, &end, 10);
+                if (*end != ',') break;
+                text = end + 1;
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            reps = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            quadratic_max = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            pattern = atoi(argv[i + 1]);
+        } else {
+            break;
+        }
+    }
+    if (i < argc || reps < 1 || reps > 64 || pattern < 1
+            || pattern > PATTERN_COUNT) {
+        fprintf(stderr, "Usage: ./typedbench [-n sizes] [-r reps] [-q max] "
+                "[-p pattern]\n");
+        exit(1);
+    }
+
+    printf("test,pattern,size,reps,pointer_ms,inline_ms,speedup\n");
+    for (n = 0; n < size_count; n++) {
+        if (sizes[n] < 1) {
+            continue;
+        }
+        keys = (int *) malloc(sizes[n] * sizeof(int));
+        if (keys == NULL) {
+            fprintf(stderr, "typedbench: no memory for %d keys\n", sizes[n]);
+            exit(1);
+        }
+        pattern_fill(keys, sizes[n], pattern, 1);
+        for (test = BENCH_SORT; test <= BENCH_FIND; test++) {
+            if (test != BENCH_SORT && sizes[n] > quadratic_max) {
+                continue;
+            }
+            // alternate the two so neither always runs on a warm cache
+            for (r = 0; r < reps; r++) {
+                list_time[r] = BenchList(keys, sizes[n], test);
+                typed_time[r] = BenchTyped(keys, sizes[n], test);
+            }
+            qsort(list_time, reps, sizeof(double), BenchCompareTime);
+            qsort(typed_time, reps, sizeof(double), BenchCompareTime);
+            printf("%s,%s,%d,%d,%.3f,%.3f,%.2f\n", test_name[test],
+                    pattern_name(pattern), sizes[n], reps,
+                    list_time[(reps - 1) / 2], typed_time[(reps - 1) / 2],
+                    list_time[(reps - 1) / 2] / typed_time[(reps - 1) / 2]);
+            fflush(stdout);
+        }
+        free(keys);
+    }
+    return 0;
+}
+
+/*** Private Functions ***/
+
+/* Runs one test on a list.h list and returns its time in milliseconds.
+ */
+double BenchList(const int *keys, int size, int test) {
+    ListPtr list_ptr = list_construct_mode(sas_compare, sas_key,
+            LIST_INTRUSIVE, NULL);
+    struct timespec start, end;
+    su_info_t rec;
+    data_t *elem_ptr;
+    int i;
+
+    memset(&rec, 0, sizeof(rec));
+    if (test != BENCH_INSERT) {
+        for (i = 0; i < size; i++) {
+            sas_addtail(list_ptr, keys[i]);
+        }
+        if (test == BENCH_FIND) {
+            list_sort(list_ptr, 6);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (test == BENCH_SORT) {
+        list_sort(list_ptr, 6);
+    }
+    else {
+        for (i = 0; i < size; i++) {
+            rec.su_id = keys[i];
+            if (test == BENCH_INSERT) {
+                elem_ptr = list_elem_alloc(list_ptr);
+                *elem_ptr = rec;
+                list_insert_sorted(list_ptr, elem_ptr);
+            }
+            else if (list_elem_find(list_ptr, &rec) == NULL) {
+                fprintf(stderr, "typedbench: list lost key %d\n", keys[i]);
+                exit(1);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    list_destruct(list_ptr);
+    return BenchMs(&start, &end);
+}
+
+/* Runs one test on a su_list and returns its time in milliseconds.
+ */
+double BenchTyped(const int *keys, int size, int test) {
+    su_list_t *list_ptr = su_list_construct();
+    su_list_node_t *node_ptr;
+    struct timespec start, end;
+    su_info_t rec;
+    int i;
+
+    memset(&rec, 0, sizeof(rec));
+    if (test != BENCH_INSERT) {
+        for (i = 0; i < size; i++) {
+            rec.su_id = keys[i];
+            su_list_insert_tail(list_ptr, &rec);
+        }
+        if (test == BENCH_FIND) {
+            su_list_sort(list_ptr);
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (test == BENCH_SORT) {
+        su_list_sort(list_ptr);
+    }
+    else {
+        for (i = 0; i < size; i++) {
+            rec.su_id = keys[i];
+            if (test == BENCH_INSERT) {
+                su_list_insert_sorted(list_ptr, &rec);
+            }
+            else if (su_list_find(list_ptr, &rec) == NULL) {
+                fprintf(stderr, "typedbench: su_list lost key %d\n", keys[i]);
+                exit(1);
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (node_ptr = su_list_front(list_ptr); node_ptr != NULL
+            && su_list_next(node_ptr) != NULL; node_ptr = su_list_next(node_ptr)) {
+        if (su_list_compare(su_list_access(node_ptr),
+                    su_list_access(su_list_next(node_ptr))) < 0) {
+            fprintf(stderr, "typedbench: su_list out of order\n");
+            exit(1);
+        }
+    }
+    su_list_destruct(list_ptr);
+    return BenchMs(&start, &end);
+}
+
+/* Milliseconds from start to end.
+ */
+double BenchMs(const struct timespec *start, const struct timespec *end) {
+    return 1000.0 * (end->tv_sec - start->tv_sec)
+        + (end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+/* qsort comparison for times, smallest first.
+ */
+int BenchCompareTime(const void *a, const void *b) {
+    double time_a = *(const double *) a;
+    double time_b = *(const double *) b;
+
+    return (time_a > time_b) - (time_a < time_b);
+}